@@ -0,0 +1,119 @@
+/* Multi-producer throughput benchmark of the command executor.
+ *
+ *   executor_bench [commands] [max producers]
+ *
+ * For 1, 2, 4 ... producers each posting its share of the commands, the
+ * owner thread runs the executor until every command has executed.  The
+ * same workload through a mutex guarded vector is reported as a baseline.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "executor.hh"
+
+using namespace nezumi;
+
+namespace
+{
+/* Representative of a publish command: touch a counter owned by the target. */
+	class count_command_t : public command_t
+	{
+	public:
+		explicit count_command_t (uint64_t* counter) : counter_ (counter) {}
+		void execute() override { ++*counter_; }
+	private:
+		uint64_t* counter_;
+	};
+
+	class locked_queue_t :
+		boost::noncopyable
+	{
+	public:
+		void post (command_t* command) {
+			boost::lock_guard<boost::mutex> locked (lock_);
+			pending_.push_back (command);
+		}
+		size_t run() {
+			{
+				boost::lock_guard<boost::mutex> locked (lock_);
+				running_.swap (pending_);
+			}
+			const size_t count = running_.size();
+			for (auto it = running_.begin(); it != running_.end(); ++it) {
+				(*it)->execute();
+				delete *it;
+			}
+			running_.clear();
+			return count;
+		}
+	private:
+		boost::mutex lock_;
+		std::vector<command_t*> pending_;
+		std::vector<command_t*> running_;
+	};
+
+	template <class Queue>
+	void produce (Queue* queue, boost::barrier* start, uint64_t* counter, size_t count) {
+		start->wait();
+		for (size_t i = 0; i < count; ++i)
+			queue->post (new count_command_t (counter));
+	}
+
+/* Returns commands per second through the owner thread. */
+	template <class Queue>
+	double measure (size_t producer_count, size_t commands) {
+		Queue queue;
+		uint64_t counter = 0;
+		boost::barrier start (static_cast<unsigned> (producer_count + 1));
+		const size_t per_producer = commands / producer_count;
+		boost::thread_group producers;
+		for (size_t p = 0; p < producer_count; ++p)
+			producers.create_thread (boost::bind (&produce<Queue>, &queue, &start, &counter, per_producer));
+		const uint64_t expected = static_cast<uint64_t> (per_producer) * producer_count;
+		start.wait();
+		const boost::chrono::steady_clock::time_point t0 = boost::chrono::steady_clock::now();
+		uint64_t executed = 0;
+		while (executed < expected)
+			executed += queue.run();
+		const boost::chrono::steady_clock::time_point t1 = boost::chrono::steady_clock::now();
+		producers.join_all();
+		const double seconds = boost::chrono::duration_cast<boost::chrono::duration<double>> (t1 - t0).count();
+		return seconds > 0 ? executed / seconds : 0;
+	}
+} /* anonymous namespace */
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	const size_t commands = argc > 1 ? strtoul (argv[1], nullptr, 10) : 4000000;
+	const size_t max_producers = argc > 2 ? strtoul (argv[2], nullptr, 10) : 8;
+	if (0 == commands || 0 == max_producers) {
+		fprintf (stderr, "usage: executor_bench [commands] [max producers]\n");
+		return EXIT_FAILURE;
+	}
+	printf ("producers  executor Mcmd/s  ns/cmd  mutex Mcmd/s  ns/cmd\n");
+	for (size_t producers = 1; producers <= max_producers; producers *= 2) {
+		const double mpsc = measure<executor_t> (producers, commands);
+		const double locked = measure<locked_queue_t> (producers, commands);
+		printf ("%9u  %15.2f  %6.1f  %12.2f  %6.1f\n",
+			static_cast<unsigned> (producers),
+			mpsc / 1e6, mpsc > 0 ? 1e9 / mpsc : 0.0,
+			locked / 1e6, locked > 0 ? 1e9 / locked : 0.0);
+	}
+	return EXIT_SUCCESS;
+}
+
+/* eof */
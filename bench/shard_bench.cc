@@ -0,0 +1,166 @@
+/* Shard scaling benchmark of the publish path without RFA.
+ *
+ *   shard_bench [symbols] [max shards] [ticks]
+ *
+ * For 1, 2, 4 ... shards the universe is partitioned by symbol_shard() and
+ * every shard thread runs its own store, wheel and record encoder through a
+ * fixed number of ticks, as shard_t::publishDue() less the provider submit.
+ * Aggregate throughput against one shard shows how close the partition comes
+ * to linear scaling before the NIC or ADH.  Symbol lookups are timed on all
+ * shards at once for both the multiply-shift partition and the former modulus.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "item_store.hh"
+#include "market_price.hh"
+#include "symbol_index.hh"
+#include "timing_wheel.hh"
+
+using namespace nezumi;
+
+namespace
+{
+	typedef record_store_t<market_price_t> store_t;
+
+	enum { kInterval = 100 };
+
+	struct result_t
+	{
+		uint64_t messages;
+		uint64_t bytes;
+		double lookup_ns;
+	};
+
+	void run_shard (const std::vector<chromium::StringPiece>* names, uint64_t ticks, boost::barrier* start, result_t* result) {
+		store_t store;
+		store.reserve (names->size());
+		for (auto it = names->begin(); it != names->end(); ++it)
+			store.insert (*it);
+		timing_wheel_t wheel;
+		wheel.reserve (store.capacity());
+		const size_t capacity = store.capacity();
+		for (item_store_t::handle_t handle = 0; handle < capacity; ++handle) {
+			store.set<market_price_t::RDNDISPLAY> (handle, 100);
+			wheel.schedule (handle, 1 + (static_cast<uint64_t> (handle) * kInterval) / capacity);
+		}
+		store_t::encoder_type encoder;
+		std::vector<timing_wheel_t::handle_t> expired;
+		uint8_t payload[256];
+		uint64_t messages = 0, bytes = 0;
+
+		start->wait();
+		for (uint64_t tick = 1; tick <= ticks; ++tick) {
+			expired.clear();
+			wheel.advance (tick, &expired);
+			for (auto it = expired.begin(); it != expired.end(); ++it) {
+				const item_store_t::handle_t handle = *it;
+				wheel.scheduleAt (handle, wheel.expiry (handle) + kInterval);
+				store.set<market_price_t::TRDPRC_1> (handle, store.nextSequence (handle));
+				bytes += encoder.encode (store.record (handle), store.dirty (handle), payload, sizeof (payload));
+				store.clearDirty (handle);
+				++messages;
+			}
+		}
+		start->wait();
+
+/* Lookups run concurrently on every shard as on the publish path. */
+		const boost::chrono::steady_clock::time_point t0 = boost::chrono::steady_clock::now();
+		size_t found = 0;
+		for (auto it = names->begin(); it != names->end(); ++it)
+			if (item_store_t::npos != store.find (*it))
+				++found;
+		const boost::chrono::steady_clock::time_point t1 = boost::chrono::steady_clock::now();
+		CHECK_EQ(names->size(), found);
+		result->messages = messages;
+		result->bytes = bytes;
+		result->lookup_ns = names->empty() ? 0 : boost::chrono::duration_cast<boost::chrono::nanoseconds> (t1 - t0).count() / static_cast<double> (names->size());
+	}
+
+/* Publish throughput in messages per second and mean lookup cost. */
+	double measure (const std::vector<std::vector<chromium::StringPiece>>& partitions, uint64_t ticks, double* lookup_ns) {
+		const size_t shard_count = partitions.size();
+		std::vector<result_t> results (shard_count);
+		boost::barrier start (static_cast<unsigned> (shard_count + 1));
+		boost::thread_group shards;
+		for (size_t i = 0; i < shard_count; ++i)
+			shards.create_thread (boost::bind (&run_shard, &partitions[i], ticks, &start, &results[i]));
+		start.wait();
+		const boost::chrono::steady_clock::time_point t0 = boost::chrono::steady_clock::now();
+		start.wait();
+		const boost::chrono::steady_clock::time_point t1 = boost::chrono::steady_clock::now();
+		shards.join_all();
+		uint64_t messages = 0;
+		double lookups = 0;
+		for (size_t i = 0; i < shard_count; ++i) {
+			messages += results[i].messages;
+			lookups += results[i].lookup_ns;
+		}
+		*lookup_ns = lookups / shard_count;
+		const double seconds = boost::chrono::duration_cast<boost::chrono::duration<double>> (t1 - t0).count();
+		return seconds > 0 ? messages / seconds : 0;
+	}
+
+	void partition (const std::vector<chromium::StringPiece>& names, size_t shard_count, bool modulus, std::vector<std::vector<chromium::StringPiece>>* partitions) {
+		partitions->assign (shard_count, std::vector<chromium::StringPiece>());
+		for (auto it = names.begin(); it != names.end(); ++it) {
+			const uint32_t hash = symbol_hash (it->data(), it->size());
+			(*partitions)[modulus ? hash % shard_count : symbol_shard (hash, shard_count)].push_back (*it);
+		}
+	}
+} /* anonymous namespace */
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	const size_t count = argc > 1 ? strtoul (argv[1], nullptr, 10) : 1000000;
+	const size_t max_shards = argc > 2 ? strtoul (argv[2], nullptr, 10) : 8;
+	const uint64_t ticks = argc > 3 ? strtoul (argv[3], nullptr, 10) : 1000;
+	if (0 == count || 0 == max_shards || 0 == ticks) {
+		fprintf (stderr, "usage: shard_bench [symbols] [max shards] [ticks]\n");
+		return EXIT_FAILURE;
+	}
+/* Sequential RIC style names, the worst case for a weak partition. */
+	std::vector<std::string> storage (count);
+	std::vector<chromium::StringPiece> names (count);
+	for (size_t i = 0; i < count; ++i) {
+		char name[32];
+		snprintf (name, sizeof (name), "R%07u.L", static_cast<unsigned> (i));
+		storage[i] = name;
+		names[i] = chromium::StringPiece (storage[i]);
+	}
+
+	printf ("shards  Mmsg/s  scaling  lookup ns  modulus lookup ns\n");
+	double base = 0;
+	std::vector<std::vector<chromium::StringPiece>> partitions;
+	for (size_t shard_count = 1; shard_count <= max_shards; shard_count *= 2) {
+		double lookup_ns, modulus_ns;
+		partition (names, shard_count, true, &partitions);
+		measure (partitions, 1, &modulus_ns);
+		partition (names, shard_count, false, &partitions);
+		const double rate = measure (partitions, ticks, &lookup_ns);
+		if (1 == shard_count)
+			base = rate;
+		printf ("%6u  %6.2f  %6.2fx  %9.1f  %17.1f\n",
+			static_cast<unsigned> (shard_count),
+			rate / 1e6, base > 0 ? rate / base : 0.0,
+			lookup_ns, modulus_ns);
+	}
+	return EXIT_SUCCESS;
+}
+
+/* eof */
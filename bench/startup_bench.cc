@@ -0,0 +1,134 @@
+/* Startup benchmark: load a generated symbol universe and create the item
+ * store of every shard.
+ *
+ *   startup_bench [count] [shards] [path]
+ *
+ * The universe file is regenerated on every run, defaults are one million
+ * symbols over four shards.  The RFA provider side of stream creation is not
+ * exercised, only the structures it populates.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "item_store.hh"
+#include "market_price.hh"
+#include "symbol_index.hh"
+#include "timing_wheel.hh"
+#include "universe.hh"
+
+using namespace nezumi;
+
+/* Budget the request set for one million symbols. */
+static const double kBudgetSeconds = 1.0;
+
+/* Exchange style names of four to ten characters, e.g. "AB12C.L". */
+static
+bool
+generate (
+	const char* path,
+	size_t count
+	)
+{
+	FILE* fp = fopen (path, "wb");
+	if (nullptr == fp)
+		return false;
+	static const char* const suffixes[] = { ".O", ".N", ".L", ".PA", ".T", "" };
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	fputs ("# generated by startup_bench\r\n", fp);
+	for (size_t i = 0; i < count; ++i) {
+		char name[16];
+		size_t length = 0;
+		size_t n = i;
+		do {
+			name[length++] = alphabet[n % 36];
+			n /= 36;
+		} while (n > 0);
+		name[length] = '\0';
+		if (0 == i % 10)
+			fprintf (fp, "%s%s %u\r\n", name, suffixes[i % 6], static_cast<unsigned> (100 + i % 900));
+		else
+			fprintf (fp, "%s%s\r\n", name, suffixes[i % 6]);
+	}
+	fclose (fp);
+	return true;
+}
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	using namespace boost::chrono;
+	const size_t count = argc > 1 ? strtoul (argv[1], nullptr, 10) : 1000000;
+	const size_t shard_count = argc > 2 ? strtoul (argv[2], nullptr, 10) : 4;
+	const char* path = argc > 3 ? argv[3] : "startup_bench_universe.txt";
+	if (0 == count || 0 == shard_count) {
+		fprintf (stderr, "usage: startup_bench [count] [shards] [path]\n");
+		return EXIT_FAILURE;
+	}
+	if (!generate (path, count)) {
+		fprintf (stderr, "Failed to write \"%s\".\n", path);
+		return EXIT_FAILURE;
+	}
+
+	const steady_clock::time_point start = steady_clock::now();
+	universe_t universe;
+	if (!universe.open (path) || count != universe.size()) {
+		fprintf (stderr, "Failed to load \"%s\".\n", path);
+		return EXIT_FAILURE;
+	}
+	const steady_clock::time_point loaded = steady_clock::now();
+
+/* As nezumi_t::createItemStreams() and shard_t::createItemStreams(). */
+	const std::vector<chromium::StringPiece>& names = universe.symbols();
+	std::vector<std::vector<chromium::StringPiece>> partitions (shard_count);
+	for (size_t i = 0; i < shard_count; ++i)
+		partitions[i].reserve (count / shard_count + 1);
+	for (size_t i = 0; i < count; ++i)
+		partitions[symbol_shard (symbol_hash (names[i].data(), names[i].size()), shard_count)].push_back (names[i]);
+	std::vector<record_store_t<market_price_t>*> stores;
+	std::vector<timing_wheel_t*> wheels;
+	for (size_t i = 0; i < shard_count; ++i) {
+		record_store_t<market_price_t>* store = new record_store_t<market_price_t>();
+		stores.push_back (store);
+		store->reserve (partitions[i].size());
+		for (auto it = partitions[i].begin(); it != partitions[i].end(); ++it) {
+			if (item_store_t::npos == store->insert (*it)) {
+				fprintf (stderr, "Duplicate symbol.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		timing_wheel_t* wheel = new timing_wheel_t();
+		wheels.push_back (wheel);
+		wheel->reserve (store->capacity());
+		for (item_store_t::handle_t handle = 0; handle < store->capacity(); ++handle)
+			wheel->schedule (handle, 1 + handle % 100);
+	}
+	const steady_clock::time_point created = steady_clock::now();
+
+	const double load_s = duration_cast<duration<double>> (loaded - start).count();
+	const double create_s = duration_cast<duration<double>> (created - loaded).count();
+	const double total_s = load_s + create_s;
+	printf ("%u symbols, %u shards: load %.3fs, create %.3fs, total %.3fs, %.0f items/s.\n",
+		static_cast<unsigned> (count), static_cast<unsigned> (shard_count),
+		load_s, create_s, total_s, total_s > 0 ? count / total_s : 0.0);
+	for (size_t i = 0; i < shard_count; ++i) {
+		delete wheels[i];
+		delete stores[i];
+	}
+/* Scale the budget for other universe sizes. */
+	const double budget_s = kBudgetSeconds * count / 1000000.0;
+	if (total_s > budget_s) {
+		printf ("Over budget of %.3fs.\n", budget_s);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/* eof */
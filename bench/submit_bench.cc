@@ -0,0 +1,143 @@
+/* Submit microbenchmark of provider_t::sendBatch() against a stub provider.
+ *
+ *   submit_bench [messages]
+ *
+ * For batch sizes 1, 2, 4 ... encode_batch_t::max_items the submit loop
+ * shared with sendBatch() runs against an OMM provider that only counts,
+ * with the once per batch mute check, counters and clock sample.  The
+ * former per-message send, a new item command, two counter updates and a
+ * clock sample per message, is reported as the baseline.  Every shard
+ * publishes through sendBatch(), with or without encode workers.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost Posix Time */
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+/* RFA 7.2 */
+#include <rfa/rfa.hh>
+
+#include "item_store.hh"
+#include "provider.hh"
+
+using namespace nezumi;
+
+namespace
+{
+	enum { kMaxBatch = 128 };
+
+/* Accepts every command, the volatile store keeps the loop from eliding. */
+	class stub_provider_t
+	{
+	public:
+		stub_provider_t() : submitted_ (0), last_ (nullptr) {}
+		uint32_t submit (rfa::sessionLayer::OMMItemCmd* cmd, void* closure) {
+			++submitted_;
+			last_ = cmd;
+			return 0;
+		}
+		uint64_t submitted() const { return submitted_; }
+	private:
+		uint64_t submitted_;
+		rfa::sessionLayer::OMMItemCmd* volatile last_;
+	};
+
+/* Provider state touched per call. */
+	struct provider_state_t
+	{
+		provider_state_t() : is_muted (false), msgs_sent (0), rfa_msgs_sent (0), batches_sent (0) {}
+		volatile bool is_muted;
+		uint32_t msgs_sent;
+		uint32_t rfa_msgs_sent;
+		uint32_t batches_sent;
+		boost::posix_time::ptime last_activity;
+	};
+
+/* As provider_t::sendBatch(). */
+	bool send_batch (provider_state_t& state, stub_provider_t& omm_provider, const item_store_t& items, const outbound_msg_t* batch, size_t count) {
+		if (state.is_muted)
+			return false;
+		submit_span (omm_provider, items, batch, count);
+		state.msgs_sent += static_cast<uint32_t> (count);
+		state.rfa_msgs_sent += static_cast<uint32_t> (count);
+		state.batches_sent++;
+		state.last_activity = boost::posix_time::microsec_clock::universal_time();
+		return true;
+	}
+
+/* As the former provider_t::send() per message, mute state was checked by
+ * both the public and the private overload.
+ */
+	bool send_one (provider_state_t& state, stub_provider_t& omm_provider, const item_store_t& items, const outbound_msg_t& message) {
+		if (state.is_muted)
+			return false;
+		if (state.is_muted)
+			return false;
+		rfa::sessionLayer::OMMItemCmd itemCmd;
+		itemCmd.setMsg (*message.msg);
+		itemCmd.setItemToken (items.token (message.handle));
+		omm_provider.submit (&itemCmd, nullptr);
+		state.rfa_msgs_sent++;
+		state.msgs_sent++;
+		state.last_activity = boost::posix_time::microsec_clock::universal_time();
+		return true;
+	}
+
+	double seconds_since (const boost::chrono::steady_clock::time_point& t0) {
+		return boost::chrono::duration_cast<boost::chrono::duration<double>> (boost::chrono::steady_clock::now() - t0).count();
+	}
+} /* anonymous namespace */
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	const size_t messages = argc > 1 ? strtoul (argv[1], nullptr, 10) : 4000000;
+	if (0 == messages) {
+		fprintf (stderr, "usage: submit_bench [messages]\n");
+		return EXIT_FAILURE;
+	}
+	item_store_t items (2);
+	items.reserve (kMaxBatch);
+	std::vector<rfa::message::RespMsg> responses (kMaxBatch);
+	outbound_msg_t outbound[kMaxBatch];
+	for (size_t i = 0; i < kMaxBatch; ++i) {
+		char name[16];
+		snprintf (name, sizeof (name), "R%03u.L", static_cast<unsigned> (i));
+		outbound[i].handle = items.insert (name);
+		outbound[i].msg = &responses[i];
+	}
+	provider_state_t state;
+	stub_provider_t omm_provider;
+
+	printf ("batch  sendBatch ns/msg  per-message ns/msg\n");
+	for (size_t batch_size = 1; batch_size <= kMaxBatch; batch_size *= 2) {
+		const size_t batches = messages / batch_size;
+		boost::chrono::steady_clock::time_point t0 = boost::chrono::steady_clock::now();
+		for (size_t i = 0; i < batches; ++i)
+			send_batch (state, omm_provider, items, outbound, batch_size);
+		const double batched_s = seconds_since (t0);
+		t0 = boost::chrono::steady_clock::now();
+		for (size_t i = 0; i < batches; ++i)
+			for (size_t j = 0; j < batch_size; ++j)
+				send_one (state, omm_provider, items, outbound[j]);
+		const double single_s = seconds_since (t0);
+		const double sent = static_cast<double> (batches * batch_size);
+		printf ("%5u  %16.1f  %18.1f\n",
+			static_cast<unsigned> (batch_size),
+			1e9 * batched_s / sent, 1e9 * single_s / sent);
+	}
+	printf ("Submitted %llu messages.\n", static_cast<unsigned long long> (omm_provider.submitted()));
+	return EXIT_SUCCESS;
+}
+
+/* eof */
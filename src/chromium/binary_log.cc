@@ -0,0 +1,338 @@
+/* Deferred formatting binary log records.
+ */
+
+#include "binary_log.hh"
+
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "atomicops.hh"
+#include "synchronization/lock_impl.hh"
+
+namespace logging {
+
+namespace {
+
+/* 1970-01-01 in FILETIME units. */
+const uint64_t kUnixEpochFiletime = 116444736000000000ULL;
+
+/* Bounded multi-producer ring of fixed size records (Vyukov), drained by one
+ * decoder thread.  A record is one claim, one copy and one release store.
+ * Any thread may drain under the drain lock: a fatal record flushes the ring
+ * ahead of itself and a producer racing Stop() flushes its own record.
+ */
+class BinaryLogRing :
+	boost::noncopyable
+{
+public:
+	enum {
+		kCellCount = 8192,
+		kCellMask = kCellCount - 1,
+		kIdleMs = 10
+	};
+
+	BinaryLogRing() : enqueue_pos_ (0), dequeue_pos_ (0), dropped_ (0), reported_ (0), is_stopped_ (0) {
+		for (size_t i = 0; i < kCellCount; ++i)
+			cells_[i].sequence = static_cast<chromium::subtle::AtomicWord> (i);
+/* Wall clock and tick count at a known counter value, records are stamped
+ * with the counter alone.
+ */
+		LARGE_INTEGER counter;
+		QueryPerformanceFrequency (&counter);
+		frequency_ = counter.QuadPart;
+		QueryPerformanceCounter (&counter);
+		base_counter_ = counter.QuadPart;
+		FILETIME now;
+		GetSystemTimeAsFileTime (&now);
+		base_filetime_ = (static_cast<uint64_t> (now.dwHighDateTime) << 32) | now.dwLowDateTime;
+		base_tickcount_ = GetTickCount();
+	}
+
+	bool Start() {
+		thread_.reset (new boost::thread (&BinaryLogRing::Run, this));
+		return (bool)thread_;
+	}
+
+/* The caller has already withdrawn the ring from new producers. */
+	void Stop() {
+		thread_->interrupt();
+		thread_->join();
+		thread_.reset();
+		chromium::subtle::NoBarrier_Store (&is_stopped_, 1);
+		chromium::subtle::MemoryBarrier();
+		Flush();
+	}
+
+/* Any thread, renders every published record before returning. */
+	void Flush() {
+		while (Drain() > 0);
+	}
+
+/* Any thread.  A full ring drops the record. */
+	void Push (const BinaryLogSite* site, const BinaryLogArgs& args) {
+		using namespace chromium::subtle;
+		Cell* cell;
+		AtomicWord pos = NoBarrier_Load (&enqueue_pos_);
+		for (;;) {
+			cell = &cells_[pos & kCellMask];
+			const AtomicWord dif = Acquire_Load (&cell->sequence) - pos;
+			if (0 == dif) {
+				const AtomicWord prev = NoBarrier_CompareAndSwap (&enqueue_pos_, pos, pos + 1);
+				if (prev == pos)
+					break;
+				pos = prev;
+			} else if (dif < 0) {
+				NoBarrier_AtomicIncrement (&dropped_, 1);
+				return;
+			} else {
+				pos = NoBarrier_Load (&enqueue_pos_);
+			}
+		}
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter (&counter);
+		cell->counter = counter.QuadPart;
+		cell->thread_id = GetCurrentThreadId();
+		cell->site = site;
+		cell->size = static_cast<uint32_t> (args.size());
+		memcpy (cell->data, args.data(), args.size());
+		Release_Store (&cell->sequence, pos + 1);
+/* A producer that loaded the ring before Stop() withdrew it may publish
+ * after the final drain, it then renders the record itself.
+ */
+		MemoryBarrier();
+		if (0 != NoBarrier_Load (&is_stopped_))
+			Flush();
+	}
+
+	uint64_t dropped() const {
+		return static_cast<uint64_t> (chromium::subtle::NoBarrier_Load (&dropped_));
+	}
+
+private:
+	struct Cell
+	{
+		volatile chromium::subtle::AtomicWord sequence;
+		const BinaryLogSite* site;
+		int64_t counter;
+		uint32_t thread_id;
+		uint32_t size;
+		uint8_t data[BinaryLogArgs::kCapacity];
+	};
+
+/* Header values of a record from its counter value. */
+	LogOrigin Origin (const Cell* cell) const {
+		const uint64_t elapsed = cell->counter > base_counter_ ? cell->counter - base_counter_ : 0;
+/* 100ns units, split to not overflow after hours of uptime. */
+		const uint64_t filetime = base_filetime_ + (elapsed / frequency_) * 10000000 + (elapsed % frequency_) * 10000000 / frequency_;
+		LogOrigin origin;
+		origin.thread_id = static_cast<int32_t> (cell->thread_id);
+		origin.time = static_cast<time_t> ((filetime - kUnixEpochFiletime) / 10000000);
+		origin.tickcount = base_tickcount_ + (elapsed / frequency_) * 1000 + (elapsed % frequency_) * 1000 / frequency_;
+		return origin;
+	}
+
+/* Renders until the ring is empty once interrupted. */
+	void Run() {
+		bool is_stopping = false;
+		while (!is_stopping) {
+			if (0 == Drain()) {
+				try {
+					boost::this_thread::sleep_for (boost::chrono::milliseconds (kIdleMs));
+				} catch (boost::thread_interrupted const&) {
+					is_stopping = true;
+				}
+			} else if (boost::this_thread::interruption_requested()) {
+				is_stopping = true;
+			}
+		}
+		while (Drain() > 0);
+	}
+
+	size_t Drain() {
+		using namespace chromium::subtle;
+		drain_lock_.Lock();
+		size_t count = 0;
+		for (;;) {
+			Cell* cell = &cells_[dequeue_pos_ & kCellMask];
+			if (Acquire_Load (&cell->sequence) != dequeue_pos_ + 1)
+				break;
+			const BinaryLogSite* site = cell->site;
+			const LogOrigin origin (Origin (cell));
+			const std::string text (BinaryLogArgs::Format (site->format, cell->data, cell->size));
+			Release_Store (&cell->sequence, dequeue_pos_ + kCellCount);
+			++dequeue_pos_;
+			++count;
+			LogMessage (site->file, site->line, site->severity, origin).stream() << text;
+		}
+		const uint64_t dropped = this->dropped();
+		if (dropped != reported_) {
+			LOG(WARNING) << "Dropped " << (dropped - reported_) << " binary log records, ring full.";
+			reported_ = dropped;
+		}
+		drain_lock_.Unlock();
+		return count;
+	}
+
+	Cell cells_[kCellCount];
+	volatile chromium::subtle::AtomicWord enqueue_pos_;
+	char padding_[64 - sizeof (chromium::subtle::AtomicWord)];
+/* Consumer state below is guarded by the drain lock.  LockImpl as Lock
+ * makes logging calls.
+ */
+	chromium::internal::LockImpl drain_lock_;
+	chromium::subtle::AtomicWord dequeue_pos_;
+	volatile chromium::subtle::AtomicWord dropped_;
+	uint64_t reported_;
+	volatile chromium::subtle::Atomic32 is_stopped_;
+	uint64_t frequency_;
+	int64_t base_counter_;
+	uint64_t base_filetime_;
+	uint64_t base_tickcount_;
+	std::unique_ptr<boost::thread> thread_;
+};
+
+/* Leaky: a racing call site may still hold the pointer after stop. */
+BinaryLogRing* g_binary_log_ring = NULL;
+
+}  /* anonymous namespace */
+
+bool StartBinaryLogging() {
+	if (g_binary_log_ring)
+		return true;
+	BinaryLogRing* ring = new BinaryLogRing();
+	if (!ring->Start())
+		return false;
+	g_binary_log_ring = ring;
+	return true;
+}
+
+void StopBinaryLogging() {
+	BinaryLogRing* ring = g_binary_log_ring;
+	if (!ring)
+		return;
+	g_binary_log_ring = NULL;
+	ring->Stop();
+}
+
+uint64_t GetDroppedBinaryLogRecordCount() {
+	BinaryLogRing* ring = g_binary_log_ring;
+	return ring ? ring->dropped() : 0;
+}
+
+void SubmitBinaryLogRecord (const BinaryLogSite* site, const BinaryLogArgs& args) {
+	BinaryLogRing* ring = g_binary_log_ring;
+	if (ring) {
+		if (site->severity < LOG_FATAL) {
+			ring->Push (site, args);
+			return;
+		}
+/* Abort here rather than on the decoder, after the records queued ahead. */
+		ring->Flush();
+	}
+	LogMessage (site->file, site->line, site->severity).stream() << BinaryLogArgs::Format (site->format, args.data(), args.size());
+}
+
+void BinaryLogArgs::Put (const char* v) {
+	if (NULL == v) {
+		PutRaw (kTagPointer, &v, sizeof (v));
+		return;
+	}
+	PutString (v, strlen (v));
+}
+
+/* Tag, one byte length then the bytes, truncated to fit. */
+void BinaryLogArgs::PutString (const char* v, size_t length) {
+	if (is_full_ || size_ + 2 > kCapacity) {
+		is_full_ = true;
+		return;
+	}
+	size_t room = kCapacity - size_ - 2;
+	if (room > 255)
+		room = 255;
+	if (length > room)
+		length = room;
+	buffer_[size_++] = kTagString;
+	buffer_[size_++] = static_cast<uint8_t> (length);
+	memcpy (buffer_ + size_, v, length);
+	size_ += length;
+}
+
+/* Arguments beyond the capacity are dropped whole, and every one after
+ * them such that the remaining arguments cannot shift into earlier {}.
+ */
+void BinaryLogArgs::PutRaw (uint8_t tag, const void* v, size_t length) {
+	if (is_full_ || size_ + 1 + length > kCapacity) {
+		is_full_ = true;
+		return;
+	}
+	buffer_[size_++] = tag;
+	memcpy (buffer_ + size_, v, length);
+	size_ += length;
+}
+
+std::string BinaryLogArgs::Format (const char* format, const uint8_t* data, size_t size) {
+	std::ostringstream ss;
+	size_t offset = 0;
+	for (const char* p = format; '\0' != *p; ++p) {
+		if ('{' != p[0] || '}' != p[1] || offset >= size) {
+			ss << *p;
+			continue;
+		}
+		++p;
+		const uint8_t tag = data[offset++];
+		switch (tag) {
+		case kTagInt: {
+			long long v; memcpy (&v, data + offset, sizeof (v)); offset += sizeof (v);
+			ss << v;
+			break;
+		}
+		case kTagUInt: {
+			unsigned long long v; memcpy (&v, data + offset, sizeof (v)); offset += sizeof (v);
+			ss << v;
+			break;
+		}
+		case kTagDouble: {
+			double v; memcpy (&v, data + offset, sizeof (v)); offset += sizeof (v);
+			ss << v;
+			break;
+		}
+		case kTagBool: {
+			bool v; memcpy (&v, data + offset, sizeof (v)); offset += sizeof (v);
+			ss << (v ? "true" : "false");
+			break;
+		}
+		case kTagChar:
+			ss << static_cast<char> (data[offset++]);
+			break;
+		case kTagString: {
+			const size_t length = data[offset++];
+			ss.write (reinterpret_cast<const char*> (data + offset), length);
+			offset += length;
+			break;
+		}
+		case kTagPointer: {
+			const void* v; memcpy (&v, data + offset, sizeof (v)); offset += sizeof (v);
+			ss << v;
+			break;
+		}
+		default:
+			offset = size;
+			break;
+		}
+	}
+	return ss.str();
+}
+
+}  /* namespace logging */
+
+/* eof */
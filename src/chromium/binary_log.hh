@@ -0,0 +1,181 @@
+/* Deferred formatting binary log records.
+ *
+ * A call site is a static descriptor of file, line, severity and format, its
+ * address is the record identifier.  Logging copies the descriptor pointer,
+ * a performance counter tick, the thread id and tagged raw argument bytes,
+ * string contents included, into a fixed size cell of a lock-free ring.  No
+ * stream, time conversion or allocation is made on the calling thread.  A
+ * decoder thread renders each record into text and hands it to LOG with the
+ * time and thread of the call.
+ *
+ * FATAL records are rendered on the calling thread after every record queued
+ * ahead of them, such that the abort happens at the call site.
+ *
+ *   BLOG(INFO, "Sent {} messages in {}ns.") (count, ns);
+ *
+ * Each {} in the format takes the next argument.  Supported arguments are
+ * integers, floating point, bool, char, C strings, std::string and pointers,
+ * strings are truncated to the space left in the record.  An argument that
+ * does not fit is dropped with every argument after it, leaving their {} in
+ * the text.
+ *
+ * Rate limited forms share the conditions of LOG_EVERY_N and friends:
+ *
+ *   BLOG_EVERY_T_SUMMARY(ERROR, 1, "Failed {}.") (id);
+ */
+
+#ifndef CHROMIUM_BINARY_LOG_HH__
+#define CHROMIUM_BINARY_LOG_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "logging.hh"
+
+namespace logging {
+
+	struct BinaryLogSite
+	{
+		const char* file;
+		int line;
+		LogSeverity severity;
+		const char* format;
+	};
+
+/* Without a running decoder records are rendered and logged immediately. */
+	bool StartBinaryLogging();
+/* Drains and renders every record, then joins the decoder. */
+	void StopBinaryLogging();
+	uint64_t GetDroppedBinaryLogRecordCount();
+
+/* Tagged argument encoding of one record. */
+	class BinaryLogArgs
+	{
+	public:
+/* A ring cell of header and arguments is two cache lines on x64. */
+		enum { kCapacity = 96 };
+		enum Tag {
+			kTagInt = 1,
+			kTagUInt,
+			kTagDouble,
+			kTagBool,
+			kTagChar,
+			kTagString,
+			kTagPointer
+		};
+
+		BinaryLogArgs() : size_ (0), is_full_ (false) {}
+
+		void Put (bool v) { PutRaw (kTagBool, &v, sizeof (v)); }
+		void Put (char v) { PutRaw (kTagChar, &v, sizeof (v)); }
+		void Put (int v) { PutInt (v); }
+		void Put (long v) { PutInt (v); }
+		void Put (long long v) { PutInt (v); }
+		void Put (unsigned v) { PutUInt (v); }
+		void Put (unsigned long v) { PutUInt (v); }
+		void Put (unsigned long long v) { PutUInt (v); }
+		void Put (double v) { PutRaw (kTagDouble, &v, sizeof (v)); }
+		void Put (const void* v) { PutRaw (kTagPointer, &v, sizeof (v)); }
+		void Put (const char* v);
+		void Put (const std::string& v) { PutString (v.data(), v.size()); }
+
+		const uint8_t* data() const { return buffer_; }
+		size_t size() const { return size_; }
+
+/* Render format with the arguments in data. */
+		static std::string Format (const char* format, const uint8_t* data, size_t size);
+
+	private:
+		void PutInt (long long v) { PutRaw (kTagInt, &v, sizeof (v)); }
+		void PutUInt (unsigned long long v) { PutRaw (kTagUInt, &v, sizeof (v)); }
+		void PutString (const char* v, size_t length);
+		void PutRaw (uint8_t tag, const void* v, size_t length);
+
+		uint8_t buffer_[kCapacity];
+		size_t size_;
+/* Set by the first dropped argument. */
+		bool is_full_;
+	};
+
+	void SubmitBinaryLogRecord (const BinaryLogSite* site, const BinaryLogArgs& args);
+
+/* Call site functor, arguments are encoded in order then submitted. */
+	class BinaryLogger
+	{
+	public:
+		explicit BinaryLogger (const BinaryLogSite* site) : site_ (site) {}
+
+		void operator() () {
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1>
+		void operator() (const A1& a1) {
+			args_.Put (a1);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1, class A2>
+		void operator() (const A1& a1, const A2& a2) {
+			args_.Put (a1); args_.Put (a2);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1, class A2, class A3>
+		void operator() (const A1& a1, const A2& a2, const A3& a3) {
+			args_.Put (a1); args_.Put (a2); args_.Put (a3);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1, class A2, class A3, class A4>
+		void operator() (const A1& a1, const A2& a2, const A3& a3, const A4& a4) {
+			args_.Put (a1); args_.Put (a2); args_.Put (a3); args_.Put (a4);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1, class A2, class A3, class A4, class A5>
+		void operator() (const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5) {
+			args_.Put (a1); args_.Put (a2); args_.Put (a3); args_.Put (a4); args_.Put (a5);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+		template <class A1, class A2, class A3, class A4, class A5, class A6>
+		void operator() (const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6) {
+			args_.Put (a1); args_.Put (a2); args_.Put (a3); args_.Put (a4); args_.Put (a5); args_.Put (a6);
+			SubmitBinaryLogRecord (site_, args_);
+		}
+
+	private:
+		const BinaryLogSite* site_;
+		BinaryLogArgs args_;
+	};
+
+/* The descriptor is constant initialized, no guard is evaluated per call.
+ */
+	#define BINARY_LOG_SITE(severity, format) \
+		([]() -> const ::logging::BinaryLogSite* { \
+			static const ::logging::BinaryLogSite site = { __FILE__, __LINE__, ::logging::LOG_ ## severity, format }; \
+			return &site; \
+		}())
+
+	#define BLOG(severity, format) \
+		!LOG_IS_ON(severity) ? (void) 0 : ::logging::BinaryLogger (BINARY_LOG_SITE(severity, format))
+
+	#define BLOG_IF_DUE(severity, due, format) \
+		!(due) ? (void) 0 : ::logging::BinaryLogger (BINARY_LOG_SITE(severity, format))
+
+	#define BLOG_FIRST_N(severity, n, format) \
+		BLOG_IF_DUE(severity, LOG_FIRST_N_IS_DUE(severity, n, false), format)
+	#define BLOG_EVERY_N(severity, n, format) \
+		BLOG_IF_DUE(severity, LOG_EVERY_N_IS_DUE(severity, n, false), format)
+	#define BLOG_EVERY_T(severity, seconds, format) \
+		BLOG_IF_DUE(severity, LOG_EVERY_T_IS_DUE(severity, seconds, false), format)
+
+	#define BLOG_FIRST_N_SUMMARY(severity, n, format) \
+		BLOG_IF_DUE(severity, LOG_FIRST_N_IS_DUE(severity, n, true), format)
+	#define BLOG_EVERY_N_SUMMARY(severity, n, format) \
+		BLOG_IF_DUE(severity, LOG_EVERY_N_IS_DUE(severity, n, true), format)
+	#define BLOG_EVERY_T_SUMMARY(severity, seconds, format) \
+		BLOG_IF_DUE(severity, LOG_EVERY_T_IS_DUE(severity, seconds, true), format)
+
+} /* namespace logging */
+
+#endif /* CHROMIUM_BINARY_LOG_HH__ */
+
+/* eof */
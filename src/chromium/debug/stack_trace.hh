@@ -7,10 +7,12 @@
 #define CHROMIUM_DEBUG_STACK_TRACE_HH__
 #pragma once
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 
 struct _EXCEPTION_POINTERS;
+struct _CONTEXT;
 
 namespace chromium {
 namespace debug {
@@ -33,6 +35,24 @@ class StackTrace {
   // on system without dbghelp 5.1.
   StackTrace(_EXCEPTION_POINTERS* exception_pointers);
 
+  // Copies the stack of a suspended thread from the stack pointer of
+  // |context| up to |stack_base| into |buffer|.  Nothing allocates, takes a
+  // lock or reads an unwind table, such that the thread may hold the heap,
+  // loader or function table lock.  Returns the bytes copied, zero when the
+  // stack pointer is outside the stack or the stack exceeds |size|.
+  static size_t CopyStack(const _CONTEXT* context, const void* stack_base,
+                          void* buffer, size_t size);
+
+  // Creates a stacktrace of another thread from its context and a stack
+  // taken by CopyStack(), after the thread resumes.  Pointers into the
+  // original stack are rewritten to the copy, the unwind reads the copy
+  // alone and ends with it.  |context| is used as scratch space.
+  StackTrace(_CONTEXT* context, void* stack_copy, size_t size);
+
+  // Initializes the symbol handler, call before any thread is suspended for
+  // a trace as initialization allocates and loads modules.
+  static void InitializeSymbols();
+
   // Copying and assignment are allowed with the default functions.
 
   ~StackTrace();
@@ -51,6 +71,8 @@ class StackTrace {
   std::string ToString() const;
 
  private:
+  void WalkStack(void* thread, _CONTEXT* context);
+
   // From http://msdn.microsoft.com/en-us/library/bb204633.aspx,
   // the sum of FramesToSkip and FramesToCapture must be less than 63,
   // so set it to 62. Even if on POSIX it could be a larger value, it usually
@@ -9,6 +9,10 @@
 
 #include <iostream>
 
+#if defined(_WIN64) && !defined(UNW_FLAG_NHANDLER)
+#define UNW_FLAG_NHANDLER 0x0
+#endif
+
 #include "../logging.hh"
 #include "../memory/singleton.hh"
 #include "../synchronization/lock.hh"
@@ -155,29 +159,118 @@ StackTrace::StackTrace()
 StackTrace::StackTrace(EXCEPTION_POINTERS* exception_pointers)
 {
   // When walking an exception stack, we need to use StackWalk64().
+  WalkStack(GetCurrentThread(), exception_pointers->ContextRecord);
+}
+
+// static
+size_t
+StackTrace::CopyStack(const CONTEXT* context, const void* stack_base,
+                      void* buffer, size_t size)
+{
+#if defined(_WIN64)
+  const DWORD64 top = reinterpret_cast<DWORD64>(stack_base);
+  const DWORD64 bottom = context->Rsp;
+  if (bottom >= top || top - bottom > size)
+    return 0;
+  // A plain loop, memcpy may be instrumented.
+  const DWORD64* src = reinterpret_cast<const DWORD64*>(bottom);
+  DWORD64* dst = static_cast<DWORD64*>(buffer);
+  const size_t count = static_cast<size_t>(top - bottom) / sizeof(DWORD64);
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = src[i];
+  return count * sizeof(DWORD64);
+#else
+  // Without unwind tables only the current instruction is recorded.
+  return 0;
+#endif
+}
+
+StackTrace::StackTrace(CONTEXT* context, void* stack_copy, size_t size)
+{
+  count_ = 0;
+#if defined(_WIN64)
+  if (0 == size) {
+    trace_[count_++] = reinterpret_cast<void*>(context->Rip);
+    return;
+  }
+  // Saved frame pointers and registers addressing the stack move with it.
+  const DWORD64 original = context->Rsp;
+  const DWORD64 copy = reinterpret_cast<DWORD64>(stack_copy);
+  DWORD64* const registers[] = {
+    &context->Rax, &context->Rcx, &context->Rdx, &context->Rbx,
+    &context->Rsp, &context->Rbp, &context->Rsi, &context->Rdi,
+    &context->R8, &context->R9, &context->R10, &context->R11,
+    &context->R12, &context->R13, &context->R14, &context->R15
+  };
+  for (size_t i = 0; i < _countof(registers); ++i) {
+    if (*registers[i] >= original && *registers[i] - original < size)
+      *registers[i] += copy - original;
+  }
+  DWORD64* words = static_cast<DWORD64*>(stack_copy);
+  for (size_t i = 0; i < size / sizeof(DWORD64); ++i) {
+    if (words[i] >= original && words[i] - original < size)
+      words[i] += copy - original;
+  }
+  // Unwind with the image tables directly rather than StackWalk64(), whose
+  // function table and module base callbacks allocate within DbgHelp.
+  while (count_ < _countof(trace_) && 0 != context->Rip &&
+         context->Rsp >= copy && context->Rsp - copy < size) {
+    const DWORD64 pc = context->Rip;
+    trace_[count_++] = reinterpret_cast<void*>(pc);
+    DWORD64 image_base;
+    PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(pc, &image_base, NULL);
+    if (NULL == function) {
+      // Only the innermost frame may be a leaf function without unwind data,
+      // its return address is at the top of the stack.
+      if (count_ > 1)
+        break;
+      context->Rip = *reinterpret_cast<const DWORD64*>(context->Rsp);
+      context->Rsp += sizeof(DWORD64);
+      continue;
+    }
+    PVOID handler_data;
+    DWORD64 establisher_frame;
+    RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, pc, function, context,
+                     &handler_data, &establisher_frame, NULL);
+  }
+#else
+  trace_[count_++] = reinterpret_cast<void*>(context->Eip);
+#endif
+}
+
+// static
+void
+StackTrace::InitializeSymbols()
+{
+  SymbolContext::GetInstance();
+}
+
+void
+StackTrace::WalkStack(void* thread, CONTEXT* context)
+{
   count_ = 0;
   // Initialize stack walking.
   STACKFRAME64 stack_frame;
   memset(&stack_frame, 0, sizeof(stack_frame));
 #if defined(_WIN64)
   int machine_type = IMAGE_FILE_MACHINE_AMD64;
-  stack_frame.AddrPC.Offset = exception_pointers->ContextRecord->Rip;
-  stack_frame.AddrFrame.Offset = exception_pointers->ContextRecord->Rbp;
-  stack_frame.AddrStack.Offset = exception_pointers->ContextRecord->Rsp;
+  stack_frame.AddrPC.Offset = context->Rip;
+  stack_frame.AddrFrame.Offset = context->Rbp;
+  stack_frame.AddrStack.Offset = context->Rsp;
 #else
   int machine_type = IMAGE_FILE_MACHINE_I386;
-  stack_frame.AddrPC.Offset = exception_pointers->ContextRecord->Eip;
-  stack_frame.AddrFrame.Offset = exception_pointers->ContextRecord->Ebp;
-  stack_frame.AddrStack.Offset = exception_pointers->ContextRecord->Esp;
+  stack_frame.AddrPC.Offset = context->Eip;
+  stack_frame.AddrFrame.Offset = context->Ebp;
+  stack_frame.AddrStack.Offset = context->Esp;
 #endif
   stack_frame.AddrPC.Mode = AddrModeFlat;
   stack_frame.AddrFrame.Mode = AddrModeFlat;
   stack_frame.AddrStack.Mode = AddrModeFlat;
   while (StackWalk64(machine_type,
                      GetCurrentProcess(),
-                     GetCurrentThread(),
+                     static_cast<HANDLE>(thread),
                      &stack_frame,
-                     exception_pointers->ContextRecord,
+                     context,
                      NULL,
                      &SymFunctionTableAccess64,
                      &SymGetModuleBase64,
@@ -14,7 +14,15 @@
 #include <cstdint>
 #include <ctime>
 #include <iomanip>
+#include <memory>
 
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "atomicops.hh"
 #include "chromium_switches.hh"
 #include "command_line.hh"
 #include "debug/stack_trace.hh"
@@ -25,6 +33,9 @@ namespace logging {
 
 DcheckState g_dcheck_state = DISABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS;
 
+// Kept within 1..2^23-1 so that it fits the upper bits of a VlogSite.
+volatile int32_t g_vlog_generation = 1;
+
 namespace {
 
 VlogInfo* g_vlog_info = nullptr;
@@ -34,6 +45,10 @@ const char* const log_severity_names[LOG_NUM_SEVERITIES] = {
 
 int min_log_level = 0;
 
+// Summarizing rate limited sites that have dropped a message, a lock-free
+// singly linked stack of LogRateSite.
+volatile chromium::subtle::AtomicWord g_rate_sites = 0;
+
 // The default set here for logging_destination will only be used if
 // InitLogging is not called.
 LoggingDestination logging_destination = LOG_ONLY_TO_SYSTEM_DEBUG_LOG;
@@ -199,6 +214,210 @@ bool InitializeLogFileHandle() {
   return true;
 }
 
+// Passes a finished message to the handler and debug destinations, returns
+// true if the message is also due to the log file.
+bool OutputLogMessage(LogSeverity severity, const char* file, int line,
+                      size_t message_start, const std::string& str) {
+// Give any log message handler first dibs on the message.
+	if (log_message_handler && log_message_handler(severity, file, line, message_start, str)) {
+// The handler took care of it, no further processing.
+		return false;
+	}
+
+	if (logging_destination == LOG_ONLY_TO_SYSTEM_DEBUG_LOG ||
+	    logging_destination == LOG_TO_BOTH_FILE_AND_SYSTEM_DEBUG_LOG) {
+	    OutputDebugStringA (str.c_str());
+	    fprintf (stderr, "%s", str.c_str());
+	    fflush (stderr);
+	} else if (severity >= kAlwaysPrintErrorLevel) {
+// When we're only outputting to a log file, above a certain log level, we
+// should still output to stderr so that we can better detect and diagnose
+// problems with unit tests, especially on the buildbots.
+		fprintf (stderr, "%s", str.c_str());
+		fflush (stderr);
+	}
+
+	return logging_destination != LOG_NONE &&
+	       logging_destination != LOG_ONLY_TO_SYSTEM_DEBUG_LOG;
+}
+
+void WriteToLogFile(const char* data, size_t length) {
+	LoggingLock::Init (LOCK_LOG_FILE, NULL);
+	LoggingLock logging_lock;
+	if (InitializeLogFileHandle()) {
+		SetFilePointer (log_file, 0, 0, SEEK_END);
+		DWORD num_written;
+		WriteFile (log_file,
+			static_cast<const void*>(data),
+			static_cast<DWORD>(length),
+			&num_written,
+			NULL);
+	}
+}
+
+// Bounded multi-producer single-consumer ring of finished messages (Vyukov).
+// A producer claims a cell with one compare-and-swap and swaps its line in,
+// taking no lock and making no system call.  The writer thread drains cells
+// in order, concatenating lines due to the log file into one write.  Any
+// thread may drain synchronously under the drain lock, a fatal message
+// flushes the ring ahead of itself and a producer racing Stop() flushes its
+// own line.
+class AsyncLogger : boost::noncopyable {
+ public:
+  enum {
+    kCellCount = 4096,
+    kCellMask = kCellCount - 1,
+    kMaxBatch = 256,
+    kIdleMs = 10
+  };
+
+  AsyncLogger() : enqueue_pos_(0), dequeue_pos_(0), dropped_(0), reported_(0), is_stopped_(0) {
+    for (size_t i = 0; i < kCellCount; ++i)
+      cells_[i].sequence = static_cast<chromium::subtle::AtomicWord>(i);
+  }
+
+  bool Start() {
+    thread_.reset(new boost::thread(&AsyncLogger::Run, this));
+    return (bool)thread_;
+  }
+
+  // The caller has already withdrawn the logger from new producers.
+  void Stop() {
+    thread_->interrupt();
+    thread_->join();
+    thread_.reset();
+    chromium::subtle::NoBarrier_Store(&is_stopped_, 1);
+    chromium::subtle::MemoryBarrier();
+    Flush();
+  }
+
+  // Any thread, writes every published message before returning.
+  void Flush() {
+    std::string batch;
+    while (Drain(&batch) > 0);
+  }
+
+  // Any thread, |str| is left empty.  A full ring drops the message.
+  void Push(LogSeverity severity, const char* file, int line,
+            size_t message_start, std::string* str) {
+    using namespace chromium::subtle;
+    Cell* cell;
+    AtomicWord pos = NoBarrier_Load(&enqueue_pos_);
+    for (;;) {
+      cell = &cells_[pos & kCellMask];
+      const AtomicWord seq = Acquire_Load(&cell->sequence);
+      const AtomicWord dif = seq - pos;
+      if (0 == dif) {
+        const AtomicWord prev = NoBarrier_CompareAndSwap(&enqueue_pos_, pos, pos + 1);
+        if (prev == pos)
+          break;
+        pos = prev;
+      } else if (dif < 0) {
+        NoBarrier_AtomicIncrement(&dropped_, 1);
+        str->clear();
+        return;
+      } else {
+        pos = NoBarrier_Load(&enqueue_pos_);
+      }
+    }
+    cell->severity = severity;
+    cell->file = file;
+    cell->line = line;
+    cell->message_start = message_start;
+    cell->str.swap(*str);
+    Release_Store(&cell->sequence, pos + 1);
+    // A producer that loaded the logger before Stop() withdrew it may publish
+    // after the final drain, it then writes the line itself.
+    MemoryBarrier();
+    if (0 != NoBarrier_Load(&is_stopped_))
+      Flush();
+  }
+
+  uint64_t dropped() const {
+    return static_cast<uint64_t>(chromium::subtle::NoBarrier_Load(&dropped_));
+  }
+
+ private:
+  struct Cell {
+    volatile chromium::subtle::AtomicWord sequence;
+    LogSeverity severity;
+    const char* file;
+    int line;
+    size_t message_start;
+    std::string str;
+  };
+
+  // Drains until the ring is empty once interrupted.
+  void Run() {
+    std::string batch;
+    bool is_stopping = false;
+    while (!is_stopping) {
+      if (0 == Drain(&batch)) {
+        try {
+          boost::this_thread::sleep_for(boost::chrono::milliseconds(kIdleMs));
+        } catch (boost::thread_interrupted const&) {
+          is_stopping = true;
+        }
+      } else if (boost::this_thread::interruption_requested()) {
+        is_stopping = true;
+      }
+    }
+    while (Drain(&batch) > 0);
+  }
+
+  size_t Drain(std::string* batch) {
+    using namespace chromium::subtle;
+    drain_lock_.Lock();
+    size_t count = 0;
+    while (count < kMaxBatch) {
+      Cell* cell = &cells_[dequeue_pos_ & kCellMask];
+      if (Acquire_Load(&cell->sequence) != dequeue_pos_ + 1)
+        break;
+      const LogSeverity severity = cell->severity;
+      const char* file = cell->file;
+      const int line = cell->line;
+      const size_t message_start = cell->message_start;
+      std::string str;
+      str.swap(cell->str);
+      Release_Store(&cell->sequence, dequeue_pos_ + kCellCount);
+      ++dequeue_pos_;
+      ++count;
+      if (OutputLogMessage(severity, file, line, message_start, str))
+        batch->append(str);
+    }
+    const uint64_t dropped = this->dropped();
+    if (dropped != reported_) {
+      std::ostringstream ss;
+      ss << "[" << log_severity_names[LOG_WARNING] << ":logging.cc(" << __LINE__ << ")] "
+         << "Dropped " << (dropped - reported_) << " log messages, ring full." << std::endl;
+      reported_ = dropped;
+      if (OutputLogMessage(LOG_WARNING, __FILE__, __LINE__, 0, ss.str()))
+        batch->append(ss.str());
+    }
+    if (!batch->empty()) {
+      WriteToLogFile(batch->data(), batch->size());
+      batch->clear();
+    }
+    drain_lock_.Unlock();
+    return count;
+  }
+
+  Cell cells_[kCellCount];
+  volatile chromium::subtle::AtomicWord enqueue_pos_;
+  char padding_[64 - sizeof (chromium::subtle::AtomicWord)];
+  // Consumer state below is guarded by the drain lock.  LockImpl as Lock
+  // makes logging calls.
+  chromium::internal::LockImpl drain_lock_;
+  chromium::subtle::AtomicWord dequeue_pos_;
+  volatile chromium::subtle::AtomicWord dropped_;
+  uint64_t reported_;
+  volatile chromium::subtle::Atomic32 is_stopped_;
+  std::unique_ptr<boost::thread> thread_;
+};
+
+// Leaky: a racing log call may still hold the pointer after stop.
+AsyncLogger* g_async_logger = NULL;
+
 }  /* anonymous namespace */
 
 bool ChromiumInitLoggingImpl(const char* new_log_file,
@@ -217,6 +436,7 @@ bool ChromiumInitLoggingImpl(const char* new_log_file,
         new VlogInfo(command_line->GetSwitchValueASCII(switches::kV),
                      command_line->GetSwitchValueASCII(switches::kVModule),
                      &min_log_level);
+    InvalidateVlogLevelCache();
   }
 
   LoggingLock::Init(lock_log, new_log_file);
@@ -248,6 +468,7 @@ bool ChromiumInitLoggingImpl(const char* new_log_file,
 
 void SetMinLogLevel(int level) {
   min_log_level = std::min(LOG_ERROR, level);
+  InvalidateVlogLevelCache();
 }
 
 int GetMinLogLevel() {
@@ -268,6 +489,112 @@ int GetVlogLevelHelper(const char*file, size_t N) {
       GetVlogVerbosity();
 }
 
+void InvalidateVlogLevelCache() {
+  using namespace chromium::subtle;
+  Atomic32 generation = NoBarrier_Load(&g_vlog_generation);
+  for (;;) {
+    const Atomic32 next = generation >= 0x7fffff ? 1 : generation + 1;
+    const Atomic32 prev = Release_CompareAndSwap(&g_vlog_generation, generation, next);
+    if (prev == generation)
+      break;
+    generation = prev;
+  }
+}
+
+// The generation is read before the level is resolved, a concurrent
+// reconfiguration leaves the site stale rather than wrong.
+int GetVlogLevelSlow(VlogSite* site, const char* file, size_t N) {
+  using namespace chromium::subtle;
+  const Atomic32 generation = Acquire_Load(&g_vlog_generation);
+  const int level = GetVlogLevelHelper(file, N);
+  if (level >= -128 && level <= 127)
+    NoBarrier_Store(site, (generation << 8) | (level & 0xff));
+  return level;
+}
+
+namespace {
+
+// Counts a dropped message, the first drop links the site for
+// LogSuppressedMessages().
+void SuppressLogMessage(LogRateSite* site) {
+  using namespace chromium::subtle;
+  NoBarrier_AtomicIncrement(&site->suppressed, 1);
+  if (0 != NoBarrier_Load(&site->registered) ||
+      0 != NoBarrier_CompareAndSwap(&site->registered, 0, 1))
+    return;
+  AtomicWord head = NoBarrier_Load(&g_rate_sites);
+  for (;;) {
+    site->next = reinterpret_cast<LogRateSite*>(head);
+    const AtomicWord prev = Release_CompareAndSwap(
+        &g_rate_sites, head, reinterpret_cast<AtomicWord>(site));
+    if (prev == head)
+      break;
+    head = prev;
+  }
+}
+
+void LogSuppressedCount(LogRateSite* site) {
+  const int32_t count =
+      chromium::subtle::NoBarrier_AtomicExchange(&site->suppressed, 0);
+  if (count > 0)
+    LogMessage(site->file, site->line, site->severity).stream()
+        << "suppressed " << count << " similar messages";
+}
+
+}  // namespace
+
+// Stops counting at n such that the counter cannot wrap.
+bool ShouldLogFirstN(LogRateSite* site, int n, bool summarize) {
+  using namespace chromium::subtle;
+  if (NoBarrier_Load(&site->occurrences) < n &&
+      NoBarrier_AtomicIncrement(&site->occurrences, 1) <= n)
+    return true;
+  if (summarize)
+    SuppressLogMessage(site);
+  return false;
+}
+
+bool ShouldLogEveryN(LogRateSite* site, int n, bool summarize) {
+  const uint32_t count = static_cast<uint32_t>(
+      chromium::subtle::NoBarrier_AtomicIncrement(&site->occurrences, 1));
+  if (n <= 1 || 1 == count % static_cast<uint32_t>(n)) {
+    if (summarize)
+      LogSuppressedCount(site);
+    return true;
+  }
+  if (summarize)
+    SuppressLogMessage(site);
+  return false;
+}
+
+// The first occurrence always logs, afterwards whichever thread moves the
+// GetTickCount() deadline on.
+bool ShouldLogEveryT(LogRateSite* site, int milliseconds, bool summarize) {
+  using namespace chromium::subtle;
+  const uint32_t now = GetTickCount();
+  const Atomic32 deadline = NoBarrier_Load(&site->deadline);
+  const bool is_first = 0 == NoBarrier_Load(&site->occurrences) &&
+      0 == NoBarrier_CompareAndSwap(&site->occurrences, 0, 1);
+  if ((is_first ||
+       static_cast<int32_t>(now - static_cast<uint32_t>(deadline)) >= 0) &&
+      deadline == NoBarrier_CompareAndSwap(&site->deadline, deadline,
+          static_cast<Atomic32>(now + milliseconds))) {
+    if (summarize)
+      LogSuppressedCount(site);
+    return true;
+  }
+  if (summarize)
+    SuppressLogMessage(site);
+  return false;
+}
+
+void LogSuppressedMessages() {
+  LogRateSite* site = reinterpret_cast<LogRateSite*>(
+      chromium::subtle::Acquire_Load(&g_rate_sites));
+  for (; NULL != site; site = site->next)
+    LogSuppressedCount(site);
+}
+
 void SetLogItems(bool enable_process_id, bool enable_thread_id,
                  bool enable_timestamp, bool enable_tickcount) {
   log_process_id = enable_process_id;
@@ -284,6 +611,29 @@ LogMessageHandlerFunction GetLogMessageHandler() {
   return log_message_handler;
 }
 
+bool StartAsyncLogging() {
+  if (g_async_logger)
+    return true;
+  AsyncLogger* async_logger = new AsyncLogger();
+  if (!async_logger->Start())
+    return false;
+  g_async_logger = async_logger;
+  return true;
+}
+
+void StopAsyncLogging() {
+  AsyncLogger* async_logger = g_async_logger;
+  if (!async_logger)
+    return;
+  g_async_logger = NULL;
+  async_logger->Stop();
+}
+
+uint64_t GetDroppedLogMessageCount() {
+  AsyncLogger* async_logger = g_async_logger;
+  return async_logger ? async_logger->dropped() : 0;
+}
+
 // MSVC doesn't like complex extern templates and DLLs.
 #if !defined(_MSC_VER)
 // Explicit instantiations for commonly used comparisons.
@@ -323,6 +673,11 @@ LogMessage::LogMessage(const char* file, int line, LogSeverity severity, std::st
   delete result;
 }
 
+LogMessage::LogMessage(const char* file, int line, LogSeverity severity, const LogOrigin& origin)
+    : severity_(severity), file_(file), line_(line) {
+  Init(file, line, &origin);
+}
+
 LogMessage::~LogMessage() {
 #ifndef NDEBUG
 	if (severity_ == LOG_FATAL) {
@@ -335,43 +690,23 @@ LogMessage::~LogMessage() {
 	stream_ << std::endl;
 	std::string str_newline(stream_.str());
 
-// Give any log message handler first dibs on the message.
-	if (log_message_handler && log_message_handler(severity_, file_, line_, message_start_, str_newline)) {
-// The handler took care of it, no further processing.
-		return;
-	}
-
-	if (logging_destination == LOG_ONLY_TO_SYSTEM_DEBUG_LOG ||
-	    logging_destination == LOG_TO_BOTH_FILE_AND_SYSTEM_DEBUG_LOG) {
-	    OutputDebugStringA (str_newline.c_str());
-	    fprintf (stderr, "%s", str_newline.c_str());
-	    fflush (stderr);
-	} else if (severity_ >= kAlwaysPrintErrorLevel) {
-// When we're only outputting to a log file, above a certain log level, we
-// should still output to stderr so that we can better detect and diagnose
-// problems with unit tests, especially on the buildbots.
-		fprintf (stderr, "%s", str_newline.c_str());
-		fflush (stderr);
-	}
-
-	LoggingLock::Init (LOCK_LOG_FILE, NULL);
-	if (logging_destination != LOG_NONE &&
-	    logging_destination != LOG_ONLY_TO_SYSTEM_DEBUG_LOG) {
-		LoggingLock logging_lock;
-		if (InitializeLogFileHandle()) {
-			SetFilePointer (log_file, 0, 0, SEEK_END);
-			DWORD num_written;
-			WriteFile (log_file,
-				static_cast<const void*>(str_newline.c_str()),
-				static_cast<DWORD>(str_newline.length()),
-				&num_written,
-				NULL);
+// Hand off to the writer thread, a fatal message must be out before abort
+// and after every message queued ahead of it.
+	AsyncLogger* async_logger = g_async_logger;
+	if (async_logger) {
+		if (severity_ < LOG_FATAL) {
+			async_logger->Push (severity_, file_, line_, message_start_, &str_newline);
+			return;
 		}
+		async_logger->Flush();
 	}
+
+	if (OutputLogMessage (severity_, file_, line_, message_start_, str_newline))
+		WriteToLogFile (str_newline.data(), str_newline.size());
 }
 
 // writes the common header info to the stream
-void LogMessage::Init(const char* file, int line) {
+void LogMessage::Init(const char* file, int line, const LogOrigin* origin) {
   std::string filename(file);
   size_t last_slash_pos = filename.find_last_of("\\/");
   if (last_slash_pos != std::string::npos)
@@ -381,9 +716,9 @@ void LogMessage::Init(const char* file, int line) {
   if (log_process_id)
     stream_ << CurrentProcessId() << ':';
   if (log_thread_id)
-    stream_ << CurrentThreadId() << ':';
+    stream_ << (origin ? origin->thread_id : CurrentThreadId()) << ':';
   if (log_timestamp) {
-    time_t t = time(NULL);
+    time_t t = origin ? origin->time : time(NULL);
     struct tm local_time = {0};
 #if _MSC_VER >= 1400
     localtime_s(&local_time, &t);
@@ -401,7 +736,7 @@ void LogMessage::Init(const char* file, int line) {
             << ':';
   }
   if (log_tickcount)
-    stream_ << TickCount() << ':';
+    stream_ << (origin ? origin->tickcount : TickCount()) << ':';
   if (severity_ >= 0)
     stream_ << log_severity_names[severity_];
   else
@@ -6,6 +6,9 @@
 #define CHROMIUM_LOGGING_HH__
 #pragma once
 
+#include <climits>
+#include <cstdint>
+#include <ctime>
 #include <sstream>
 
 /* Boost noncopyable base class */
@@ -26,9 +29,15 @@
  *
  *   LOG_IF(INFO, num_cookies > 10) << "Got lots of cookies";
  *
+ * Hot statements can be rate limited:
+ *
+ *   LOG_EVERY_N(INFO, 10) << "Got a cookie";
+ *
  * The above will cause log messages to be output on the 1st, 11th, 21st, ...
- * times it is executed.  Note that the special COUNTER value is used to
- * identify which repetition is happening.
+ * times it is executed.  LOG_FIRST_N(INFO, 20) outputs only the first 20 and
+ * LOG_EVERY_T(INFO, 1.5) at most one message each 1.5 seconds.  The _SUMMARY
+ * variants count what they drop and log "suppressed N similar messages"
+ * ahead of the next message and from LogSuppressedMessages() on shutdown.
  *
  * The CHECK(condition) macro is active in both debug and release builds and
  * effectively performs a LOG(FATAL) which terminates the process and
@@ -162,6 +171,48 @@ inline bool InitLogging(const char* log_file,
 		return GetVlogLevelHelper (file, N);
 	}
 
+/* Resolved level of one VLOG call site, the verbosity generation in the upper
+ * 24 bits and the signed level in the lower 8.  Zero never matches.
+ */
+	typedef volatile int32_t VlogSite;
+
+/* Changes only when verbosity is reconfigured, e.g. SetMinLogLevel(). */
+	extern volatile int32_t g_vlog_generation;
+	void InvalidateVlogLevelCache();
+	int GetVlogLevelSlow (VlogSite* site, const char* file_start, size_t N);
+
+	template <size_t N>
+	int GetVlogLevel (VlogSite* site, const char (&file)[N]) {
+		const int32_t cached = *site;
+		if ((cached >> 8) == g_vlog_generation)
+			return static_cast<int8_t> (cached & 0xff);
+		return GetVlogLevelSlow (site, file, N);
+	}
+
+/* Lock-free state of one rate limited call site, constant initialized with
+ * the location and severity, the counters start at zero.
+ */
+	struct LogRateSite
+	{
+		const char* file;
+		int line;
+		int severity;
+		volatile int32_t occurrences;
+		volatile int32_t suppressed;
+		volatile int32_t deadline;
+		volatile int32_t registered;
+		LogRateSite* next;
+	};
+
+/* Return whether this occurrence is logged, with summarize a dropped one is
+ * counted and a logged one is preceded by the count dropped since the last.
+ */
+	bool ShouldLogFirstN (LogRateSite* site, int n, bool summarize);
+	bool ShouldLogEveryN (LogRateSite* site, int n, bool summarize);
+	bool ShouldLogEveryT (LogRateSite* site, int milliseconds, bool summarize);
+/* Logs the outstanding count of every summarizing site, e.g. on shutdown. */
+	void LogSuppressedMessages();
+
 // Sets the common items you want to be prepended to each log message.
 // process and thread IDs default to off, the timestamp defaults to on.
 // If this function is not called, logging defaults to writing the timestamp
@@ -178,6 +229,16 @@ inline bool InitLogging(const char* log_file,
 	void SetLogMessageHandler(LogMessageHandlerFunction handler);
 	LogMessageHandlerFunction GetLogMessageHandler();
 
+// Hands finished messages to a background writer thread.  A log call moves
+// its line into a bounded lock-free ring and returns, the writer passes each
+// line to the message handler and other destinations and writes the log file
+// in large batches.  A full ring drops the message and counts it, such that
+// logging never blocks.  FATAL messages remain synchronous.
+	bool StartAsyncLogging();
+// Drains the ring and joins the writer, subsequent messages are synchronous.
+	void StopAsyncLogging();
+	uint64_t GetDroppedLogMessageCount();
+
 	typedef int LogSeverity;
 	const LogSeverity LOG_VERBOSE = -1;
 /* Note: the log severities are used to index into the array of names,
@@ -235,14 +296,34 @@ inline bool InitLogging(const char* log_file,
 /* Needed for LOG_IS_ON(ERROR). */
 	const LogSeverity LOG_0 = LOG_ERROR;
 
+/* Statements below the build-time NEZUMI_MIN_LOG_LEVEL are constant false
+ * and compile to nothing, arguments included.  VLOG(n) has severity -n, e.g.
+ * -DNEZUMI_MIN_LOG_LEVEL=1 keeps WARNING and above.  CHECK never strips.
+ */
+	#ifndef NEZUMI_MIN_LOG_LEVEL
+	#	define NEZUMI_MIN_LOG_LEVEL INT_MIN
+	#endif
+/* LOG_FATAL */
+	#if NEZUMI_MIN_LOG_LEVEL > 3
+	#	error "NEZUMI_MIN_LOG_LEVEL must not exceed LOG_FATAL."
+	#endif
+
 	#define LOG_IS_ON(severity) \
-		((::logging::LOG_ ## severity) >= ::logging::GetMinLogLevel())
+		((::logging::LOG_ ## severity) >= NEZUMI_MIN_LOG_LEVEL && \
+		 (::logging::LOG_ ## severity) >= ::logging::GetMinLogLevel())
 
-/* Using the v-logging functions in conjunction with --vmodule
- * may be slow.
+/* The level is cached per call site, --vmodule patterns are matched once
+ * per site and verbosity generation.
  */
+	#define VLOG_SITE() \
+		([]() -> ::logging::VlogSite* { \
+			static ::logging::VlogSite site = 0; \
+			return &site; \
+		}())
+
 	#define VLOG_IS_ON(verboselevel) \
-		((verboselevel) <= ::logging::GetVlogLevel(__FILE__))
+		(-(verboselevel) >= NEZUMI_MIN_LOG_LEVEL && \
+		 (verboselevel) <= ::logging::GetVlogLevel(VLOG_SITE(), __FILE__))
 
 /* Helper macro which avoids evaluating the arguments to a stream if
  * the condition doesn't hold.
@@ -270,6 +351,38 @@ inline bool InitLogging(const char* log_file,
 		LAZY_STREAM(VLOG_STREAM(verbose_level), \
 			VLOG_IS_ON(verbose_level) && (condition))
 
+/* Rate limited logging, conditions first such that BLOG may share them. */
+	#define LOG_RATE_SITE(severity) \
+		([]() -> ::logging::LogRateSite* { \
+			static ::logging::LogRateSite site = { __FILE__, __LINE__, ::logging::LOG_ ## severity }; \
+			return &site; \
+		}())
+
+	#define LOG_FIRST_N_IS_DUE(severity, n, summarize) \
+		(LOG_IS_ON(severity) && \
+			::logging::ShouldLogFirstN (LOG_RATE_SITE(severity), (n), (summarize)))
+	#define LOG_EVERY_N_IS_DUE(severity, n, summarize) \
+		(LOG_IS_ON(severity) && \
+			::logging::ShouldLogEveryN (LOG_RATE_SITE(severity), (n), (summarize)))
+	#define LOG_EVERY_T_IS_DUE(severity, seconds, summarize) \
+		(LOG_IS_ON(severity) && \
+			::logging::ShouldLogEveryT (LOG_RATE_SITE(severity), \
+				static_cast<int> ((seconds) * 1000), (summarize)))
+
+	#define LOG_FIRST_N(severity, n) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_FIRST_N_IS_DUE(severity, n, false))
+	#define LOG_EVERY_N(severity, n) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_EVERY_N_IS_DUE(severity, n, false))
+	#define LOG_EVERY_T(severity, seconds) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_EVERY_T_IS_DUE(severity, seconds, false))
+
+	#define LOG_FIRST_N_SUMMARY(severity, n) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_FIRST_N_IS_DUE(severity, n, true))
+	#define LOG_EVERY_N_SUMMARY(severity, n) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_EVERY_N_IS_DUE(severity, n, true))
+	#define LOG_EVERY_T_SUMMARY(severity, seconds) \
+		LAZY_STREAM(LOG_STREAM(severity), LOG_EVERY_T_IS_DUE(severity, seconds, true))
+
 	#define LOG_ASSERT(condition)  \
 		LOG_IF(FATAL, !(condition)) << "Assert failed: " #condition ". "
 
@@ -522,6 +635,16 @@ inline bool InitLogging(const char* log_file,
  * though.  You should use the LOG() macro (and variants thereof)
  * above.
  */
+/* Header values of a message captured on another thread, i.e. deferred
+ * binary log records rendered by the decoder.
+ */
+	struct LogOrigin
+	{
+		int32_t thread_id;
+		time_t time;
+		uint64_t tickcount;
+	};
+
 	class LogMessage :
 		boost::noncopyable
 	{
@@ -558,12 +681,17 @@ inline bool InitLogging(const char* log_file,
  */
 		LogMessage (const char* file, int line, LogSeverity severity, std::string* result);
 
+/* Used for deferred records, the header takes the thread and time of the
+ * origin instead of the current thread.
+ */
+		LogMessage (const char* file, int line, LogSeverity severity, const LogOrigin& origin);
+
 		~LogMessage();
 
 		std::ostream& stream() { return stream_; }
 
 	private:
-		void Init (const char* file_, int line_);
+		void Init (const char* file_, int line_, const LogOrigin* origin = NULL);
 
 		LogSeverity severity_;
 		std::ostringstream stream_;
@@ -106,6 +106,7 @@ int VlogInfo::GetVlogLevel(const chromium::StringPiece& file) const {
 void VlogInfo::SetMaxVlogLevel(int level) {
   // Log severity is the negative verbosity.
   *min_log_level_ = -level;
+  InvalidateVlogLevelCache();
 }
 
 int VlogInfo::GetMaxVlogLevel() const {
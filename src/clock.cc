@@ -0,0 +1,43 @@
+/* Timer clocks.
+ */
+
+#include "clock.hh"
+
+#include "chromium/synchronization/lock.hh"
+
+namespace
+{
+/* A lock rather than atomics as the time point is 64-bit on 32-bit targets. */
+	chromium::Lock g_lock;
+	nezumi::virtual_clock_t::time_point g_now;
+} /* anonymous namespace */
+
+const bool nezumi::virtual_clock_t::is_steady;
+
+nezumi::virtual_clock_t::time_point
+nezumi::virtual_clock_t::now()
+{
+	chromium::AutoLock locked (g_lock);
+	return g_now;
+}
+
+void
+nezumi::virtual_clock_t::reset (
+	const time_point& t
+	)
+{
+	chromium::AutoLock locked (g_lock);
+	g_now = t;
+}
+
+void
+nezumi::virtual_clock_t::advance (
+	const time_point& t
+	)
+{
+	chromium::AutoLock locked (g_lock);
+	if (t > g_now)
+		g_now = t;
+}
+
+/* eof */
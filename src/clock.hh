@@ -0,0 +1,88 @@
+/* Timer clocks.
+ *
+ * The publish timer is templated on a Boost.Chrono clock and blocks through
+ * sleep_traits_t of that clock.  Real clocks sleep on the steady clock with
+ * an optional final spin.  The virtual clock only moves when advanced and
+ * sleeping on it advances it to the wake-up time at once, such that a timer
+ * driven by it runs as fast as its consumers allow and stamps every tick
+ * identically from run to run.
+ */
+
+#ifndef __CLOCK_HH__
+#define __CLOCK_HH__
+#pragma once
+
+/* SSE2 spin-wait hint. */
+#include <emmintrin.h>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+namespace nezumi
+{
+/* One process-wide simulated time line, any thread may read or advance. */
+	class virtual_clock_t
+	{
+	public:
+		typedef boost::chrono::nanoseconds duration;
+		typedef duration::rep rep;
+		typedef duration::period period;
+		typedef boost::chrono::time_point<virtual_clock_t> time_point;
+		static const bool is_steady = true;
+
+		static time_point now();
+
+/* Place the time line, e.g. at the system clock on start-up. */
+		static void reset (const time_point& t);
+/* Move forward to t, an earlier time is ignored. */
+		static void advance (const time_point& t);
+	};
+
+	template<class Clock>
+	struct sleep_traits_t
+	{
+/* Block until t with a final spin budget, returns the wake-up lateness
+ * measured on the steady clock.
+ */
+		template<class Duration>
+		static boost::chrono::microseconds sleep_until (const boost::chrono::time_point<Clock, Duration>& t, boost::chrono::microseconds spin)
+		{
+			using namespace boost::chrono;
+			const steady_clock::time_point deadline = steady_clock::now() + duration_cast<steady_clock::duration> (t - Clock::now());
+			if (spin.count() <= 0) {
+				boost::this_thread::sleep_until (deadline);
+			} else {
+				const steady_clock::time_point wake = deadline - spin;
+				if (steady_clock::now() < wake)
+					boost::this_thread::sleep_until (wake);
+				while (steady_clock::now() < deadline) {
+					boost::this_thread::interruption_point();
+					_mm_pause();
+				}
+			}
+			const steady_clock::duration late = steady_clock::now() - deadline;
+			return late.count() > 0 ? duration_cast<microseconds> (late) : microseconds (0);
+		}
+	};
+
+/* Never late, never blocks. */
+	template<>
+	struct sleep_traits_t<virtual_clock_t>
+	{
+		template<class Duration>
+		static boost::chrono::microseconds sleep_until (const boost::chrono::time_point<virtual_clock_t, Duration>& t, boost::chrono::microseconds spin)
+		{
+			boost::this_thread::interruption_point();
+			virtual_clock_t::advance (boost::chrono::time_point_cast<virtual_clock_t::duration> (t));
+			return boost::chrono::microseconds (0);
+		}
+	};
+
+} /* namespace nezumi */
+
+#endif /* __CLOCK_HH__ */
+
+/* eof */
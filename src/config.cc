@@ -18,10 +18,41 @@ nezumi::config_t::config_t() :
 	event_queue_name ("EventQueueName"),
 	connection_name ("ConnectionName"),
 	publisher_name ("PublisherName"),
-	vendor_name ("VendorName")
+	vendor_name ("VendorName"),
+	universe_path (""),
+	shard_count (1),
+	encode_threads (0),
+	timer_resolution_us (10000),
+	timer_spin_us (0),
+	publish_interval_ms (1000),
+	publish_stagger (true),
+	timer_catchup ("burst"),
+	reactor_mode (false),
+	watchdog_threshold_ms (1000),
+	simulation_seconds (0)
 {
 /* C++11 initializer lists not supported in MSVC2010 */
 	rssl_servers.push_back ("nylabadh2");
 }
 
+nezumi::config_t
+nezumi::config_t::shard (
+	size_t index
+	) const
+{
+	std::ostringstream ss;
+	ss << '.' << index;
+	const std::string suffix (ss.str());
+	config_t config (*this);
+	config.event_queue_name += suffix;
+	if (shard_count > 1) {
+		config.session_name += suffix;
+		config.connection_name += suffix;
+		config.publisher_name += suffix;
+/* Infrastructure rejects a second login with the same InstanceId. */
+		config.instance_id += suffix;
+	}
+	return config;
+}
+
 /* eof */
@@ -7,6 +7,7 @@
 #define __CONFIG_HH__
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -18,6 +19,12 @@ namespace nezumi
 	{
 		config_t();
 
+/* Copy with RFA entity names specific to one shard, suffixed ".<shard>"
+ * when more than one shard is configured.  The event queue name is always
+ * suffixed as the application retains its own queue.
+ */
+		config_t shard (size_t index) const;
+
 //  Windows registry key path.
 		std::string key;
 
@@ -72,6 +79,72 @@ namespace nezumi
 
 //  RFA vendor name.
 		std::string vendor_name;
+
+/* Symbol universe file, one RIC per line.
+ * Range: "" (publish MSFT.O only) or path to a local file.
+ */
+		std::string universe_path;
+
+/* Number of publishing shards, each with a dedicated RFA session,
+ * connection, provider, event queue and thread.  Symbols are partitioned by
+ * hash of the RIC.
+ * Range: 1 or more, typically no more than physical cores.
+ */
+		size_t shard_count;
+
+/* Encode worker threads per shard, the shard thread then only submits.
+ * Range: 0 (encode on the shard thread) to remaining cores per shard.
+ */
+		size_t encode_threads;
+
+/* Publish schedule granularity, the timer period and timing wheel tick.
+ * Range: 1 or more microseconds, without a spin budget the Windows timer
+ * resolution limits accuracy to 1-15ms.  Finer ticks yield smaller slices.
+ */
+		unsigned timer_resolution_us;
+
+/* Final stretch before each timer deadline spent spinning on the steady
+ * clock rather than sleeping, consumes the timer core for that time.
+ * Range: 0 (sleep only) to timer_resolution_us.
+ */
+		unsigned timer_spin_us;
+
+/* Publish interval of items without one in the universe file.
+ * Range: timer resolution or more.
+ */
+		unsigned publish_interval_ms;
+
+/* Spread items of each interval evenly across it by a phase offset derived
+ * from the item index, each timer tick then publishes a small slice rather
+ * than every item leaving at the top of the interval.
+ * Range: true or false.
+ */
+		bool publish_stagger;
+
+/* Timer handling of ticks missed after an overrun or stall.
+ * Range: "burst", "coalesce", "skip".
+ */
+		std::string timer_catchup;
+
+/* Run timers inline on each shard thread rather than on a timer thread: the
+ * shard waits for RFA events only until its next tick deadline, without the
+ * cross-thread hand-off.  Late ticks always coalesce.
+ * Range: true or false.
+ */
+		bool reactor_mode;
+
+/* Flag a shard thread busy in one callback or command run for this long as
+ * stalled and log its stack.
+ * Range: 0 (disabled) or more milliseconds.
+ */
+		unsigned watchdog_threshold_ms;
+
+/* Publish this many seconds of schedule on a virtual clock as fast as the
+ * shards keep up, then exit.  Each timer tick completes on every shard before
+ * the next, such that runs repeat exactly.  Not with reactor mode.
+ * Range: 0 (real time) or more seconds.
+ */
+		unsigned simulation_seconds;
 	};
 
 	inline
@@ -99,6 +172,17 @@ namespace nezumi
 			", \"connection_name\": \"" << config.connection_name << "\""
 			", \"publisher_name\": \"" << config.publisher_name << "\""
 			", \"vendor_name\": \"" << config.vendor_name << "\""
+			", \"universe_path\": \"" << config.universe_path << "\""
+			", \"shard_count\": " << config.shard_count <<
+			", \"encode_threads\": " << config.encode_threads <<
+			", \"timer_resolution_us\": " << config.timer_resolution_us <<
+			", \"timer_spin_us\": " << config.timer_spin_us <<
+			", \"publish_interval_ms\": " << config.publish_interval_ms <<
+			", \"publish_stagger\": " << (config.publish_stagger ? "true" : "false") <<
+			", \"timer_catchup\": \"" << config.timer_catchup << "\""
+			", \"reactor_mode\": " << (config.reactor_mode ? "true" : "false") <<
+			", \"watchdog_threshold_ms\": " << config.watchdog_threshold_ms <<
+			", \"simulation_seconds\": " << config.simulation_seconds <<
 			" }";
 		return o;
 	}
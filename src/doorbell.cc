@@ -0,0 +1,51 @@
+/* Cross-thread wake-up of a waiting owner thread.
+ */
+
+#include "doorbell.hh"
+
+#include "chromium/logging.hh"
+
+nezumi::doorbell_t::doorbell_t() :
+	is_rung_ (0)
+{
+}
+
+bool
+nezumi::doorbell_t::init()
+{
+	event_.reset (::CreateEvent (nullptr, FALSE /* auto-reset */, FALSE, nullptr));
+	if (!event_) {
+		LOG(ERROR) << "CreateEvent: { \"GetLastError\": " << ::GetLastError() << " }";
+		return false;
+	}
+	return true;
+}
+
+void
+nezumi::doorbell_t::ring()
+{
+	if (0 == chromium::subtle::NoBarrier_AtomicExchange (&is_rung_, 1))
+		::SetEvent (event_.get());
+}
+
+/* A consumed ring may leave the event signalled, the next wait then returns
+ * early and finds the latch clear, a spurious but harmless wake-up.
+ */
+bool
+nezumi::doorbell_t::poll()
+{
+	return 0 != chromium::subtle::NoBarrier_AtomicExchange (&is_rung_, 0);
+}
+
+bool
+nezumi::doorbell_t::wait (
+	unsigned long timeout_ms
+	)
+{
+	if (poll())
+		return true;
+	::WaitForSingleObject (event_.get(), timeout_ms);
+	return poll();
+}
+
+/* eof */
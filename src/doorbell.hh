@@ -0,0 +1,48 @@
+/* Cross-thread wake-up of a waiting owner thread.
+ *
+ * Auto-reset Win32 event behind an atomic latch, like an eventfd: rings
+ * coalesce until the owner consumes them and only the first ring after a
+ * consume makes a system call.  The owner may also poll the latch without a
+ * kernel transition whilst spinning towards a deadline.
+ */
+
+#ifndef __DOORBELL_HH__
+#define __DOORBELL_HH__
+#pragma once
+
+#include <cstdint>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "chromium/atomicops.hh"
+#include "microsoft/unique_handle.hh"
+
+namespace nezumi
+{
+	class doorbell_t :
+		boost::noncopyable
+	{
+	public:
+		doorbell_t();
+
+		bool init();
+
+/* Any thread. */
+		void ring();
+
+/* Owner thread only.  Returns true if rung, consuming the ring. */
+		bool poll();
+/* Owner thread only.  Block up to timeout_ms, returns true if rung. */
+		bool wait (unsigned long timeout_ms);
+
+	private:
+		volatile chromium::subtle::Atomic32 is_rung_;
+		ms::handle event_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __DOORBELL_HH__ */
+
+/* eof */
@@ -0,0 +1,161 @@
+/* Encode worker pool.
+ */
+
+#include "encode_pool.hh"
+
+#include "chromium/logging.hh"
+
+using chromium::subtle::AtomicWord;
+
+nezumi::encode_pool_t::encode_pool_t (
+	size_t worker_count
+	) :
+	next_ (0),
+	pending_ (0),
+	stolen_ (0),
+	is_stopping_ (false)
+{
+	for (size_t i = 0; i < worker_count; ++i)
+		workers_.push_back (std::unique_ptr<worker_t> (new worker_t));
+}
+
+nezumi::encode_pool_t::~encode_pool_t()
+{
+	stop();
+}
+
+bool
+nezumi::encode_pool_t::start()
+{
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		workers_[i]->thread.reset (new boost::thread (&encode_pool_t::workerLoop, this, i));
+		if (!(bool)workers_[i]->thread)
+			return false;
+	}
+	VLOG(2) << "Started " << workers_.size() << " encode workers.";
+	return true;
+}
+
+void
+nezumi::encode_pool_t::stop()
+{
+	{
+		boost::lock_guard<boost::mutex> lock (idle_lock_);
+		is_stopping_ = true;
+	}
+	idle_.notify_all();
+	for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+		if ((bool)(*it)->thread) {
+			(*it)->thread->join();
+			(*it)->thread.reset();
+		}
+	}
+}
+
+void
+nezumi::encode_pool_t::submit (
+	encode_task_t* task
+	)
+{
+	DCHECK(nullptr != task);
+/* No workers, encode inline. */
+	if (workers_.empty()) {
+		task->encode (0);
+		return;
+	}
+	worker_t& worker = *workers_[next_];
+	if (++next_ == workers_.size())
+		next_ = 0;
+	{
+		chromium::AutoLock lock (worker.lock);
+		worker.tasks.push_back (task);
+	}
+/* Publish the count before the wake-up such that a worker checking under
+ * the idle lock cannot miss the task.
+ */
+	chromium::subtle::Barrier_AtomicIncrement (&pending_, 1);
+	{
+		boost::lock_guard<boost::mutex> lock (idle_lock_);
+	}
+	idle_.notify_one();
+}
+
+bool
+nezumi::encode_pool_t::help()
+{
+	if (0 == chromium::subtle::Acquire_Load (&pending_))
+		return false;
+	for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+		encode_task_t* task = pop (**it, true);
+		if (nullptr != task) {
+			task->encode (workers_.size());
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+nezumi::encode_pool_t::workerLoop (
+	size_t index
+	)
+{
+	while (true) {
+		encode_task_t* task = take (index);
+		if (nullptr != task) {
+			task->encode (index);
+			continue;
+		}
+		boost::unique_lock<boost::mutex> lock (idle_lock_);
+		while (!is_stopping_ && 0 == chromium::subtle::Acquire_Load (&pending_))
+			idle_.wait (lock);
+		if (is_stopping_)
+			break;
+	}
+}
+
+/* Own deque first, then steal from the next worker round.
+ */
+nezumi::encode_task_t*
+nezumi::encode_pool_t::take (
+	size_t index
+	)
+{
+	encode_task_t* task = pop (*workers_[index], true);
+	if (nullptr != task)
+		return task;
+	const size_t count = workers_.size();
+	for (size_t i = 1; i < count; ++i) {
+		task = pop (*workers_[(index + i) % count], false);
+		if (nullptr != task) {
+			chromium::subtle::NoBarrier_AtomicIncrement (&stolen_, 1);
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+nezumi::encode_task_t*
+nezumi::encode_pool_t::pop (
+	worker_t& worker,
+	bool oldest
+	)
+{
+	encode_task_t* task;
+	{
+		chromium::AutoLock lock (worker.lock);
+		if (worker.tasks.empty())
+			return nullptr;
+		if (oldest) {
+			task = worker.tasks.front();
+			worker.tasks.pop_front();
+		} else {
+			task = worker.tasks.back();
+			worker.tasks.pop_back();
+		}
+	}
+	chromium::subtle::Barrier_AtomicIncrement (&pending_, -1);
+	return task;
+}
+
+/* eof */
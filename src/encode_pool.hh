@@ -0,0 +1,89 @@
+/* Encode worker pool.
+ *
+ * A fixed set of threads executing encode tasks issued by a single owner
+ * thread, the submitter.  Tasks are dealt round-robin onto per-worker deques,
+ * a worker takes the oldest task of its own deque and when empty steals the
+ * newest from another, leaving the tasks nearest submission to their owner.
+ * The submitter may execute tasks itself whilst waiting on a result.
+ *
+ * Completion is not signalled by the pool, tasks publish their own results.
+ */
+
+#ifndef __ENCODE_POOL_HH__
+#define __ENCODE_POOL_HH__
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "chromium/atomicops.hh"
+#include "chromium/synchronization/lock.hh"
+
+namespace nezumi
+{
+	class encode_task_t
+	{
+	public:
+		virtual ~encode_task_t() {}
+/* Worker index in [0, size()], size() denotes the submitter. */
+		virtual void encode (size_t worker) = 0;
+	};
+
+	class encode_pool_t :
+		boost::noncopyable
+	{
+	public:
+		explicit encode_pool_t (size_t worker_count);
+		~encode_pool_t();
+
+		bool start();
+		void stop();
+
+		size_t size() const { return workers_.size(); }
+
+/* Owner thread only, task is not owned and must outlive execution. */
+		void submit (encode_task_t* task);
+/* Owner thread only, execute the oldest queued task of any worker.  Returns
+ * false when nothing is queued.
+ */
+		bool help();
+
+		uint64_t stolen() const { return static_cast<uint64_t> (chromium::subtle::NoBarrier_Load (&stolen_)); }
+
+	private:
+		struct worker_t
+		{
+			chromium::Lock lock;
+			std::deque<encode_task_t*> tasks;
+			std::unique_ptr<boost::thread> thread;
+		};
+
+		void workerLoop (size_t index);
+		encode_task_t* take (size_t index);
+		encode_task_t* pop (worker_t& worker, bool oldest);
+
+		std::vector<std::unique_ptr<worker_t>> workers_;
+		size_t next_;
+
+/* Tasks queued across all workers, read by idle workers before parking. */
+		volatile chromium::subtle::AtomicWord pending_;
+		volatile chromium::subtle::AtomicWord stolen_;
+
+		boost::mutex idle_lock_;
+		boost::condition_variable idle_;
+		bool is_stopping_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __ENCODE_POOL_HH__ */
+
+/* eof */
@@ -0,0 +1,106 @@
+/* Single-writer command executor.
+ */
+
+#include "executor.hh"
+
+#include "chromium/logging.hh"
+
+using chromium::subtle::AtomicWord;
+
+nezumi::executor_t::executor_t() :
+	head_ (reinterpret_cast<AtomicWord> (&stub_)),
+	tail_ (&stub_),
+	executed_ (0),
+	max_batch_ (0)
+{
+}
+
+nezumi::executor_t::~executor_t()
+{
+	size_t discarded = 0;
+	command_t* command;
+	while (nullptr != (command = pop())) {
+		delete command;
+		++discarded;
+	}
+	if (discarded > 0)
+		LOG(WARNING) << "Discarded " << discarded << " pending commands.";
+}
+
+void
+nezumi::executor_t::post (
+	command_t* command
+	)
+{
+	DCHECK(nullptr != command);
+	push (command);
+}
+
+/* Commands posted whilst running are deferred to the next call so that a
+ * busy producer cannot starve the owner thread of its other work.
+ */
+size_t
+nezumi::executor_t::run()
+{
+	const mpsc_node_t* last = reinterpret_cast<const mpsc_node_t*> (chromium::subtle::Acquire_Load (&head_));
+	size_t count = 0;
+	command_t* command;
+	while (nullptr != (command = pop())) {
+		const bool is_last = (command == last);
+		command->execute();
+		delete command;
+		++count;
+		if (is_last)
+			break;
+	}
+	executed_ += count;
+	if (count > max_batch_)
+		max_batch_ = count;
+	return count;
+}
+
+/* Wait-free for producers: one exchange then link the previous head.
+ */
+void
+nezumi::executor_t::push (
+	mpsc_node_t* node
+	)
+{
+	chromium::subtle::NoBarrier_Store (&node->next, 0);
+	mpsc_node_t* prev = reinterpret_cast<mpsc_node_t*> (
+		chromium::subtle::NoBarrier_AtomicExchange (&head_, reinterpret_cast<AtomicWord> (node)));
+	chromium::subtle::Release_Store (&prev->next, reinterpret_cast<AtomicWord> (node));
+}
+
+/* Returns nullptr when empty or when a producer is between exchange and
+ * link, the command becomes visible on a later call.
+ */
+nezumi::command_t*
+nezumi::executor_t::pop()
+{
+	mpsc_node_t* tail = tail_;
+	mpsc_node_t* next = reinterpret_cast<mpsc_node_t*> (chromium::subtle::Acquire_Load (&tail->next));
+	if (&stub_ == tail) {
+		if (nullptr == next)
+			return nullptr;
+		tail_ = tail = next;
+		next = reinterpret_cast<mpsc_node_t*> (chromium::subtle::Acquire_Load (&next->next));
+	}
+	if (nullptr != next) {
+		tail_ = next;
+		return static_cast<command_t*> (tail);
+	}
+	const mpsc_node_t* head = reinterpret_cast<const mpsc_node_t*> (chromium::subtle::Acquire_Load (&head_));
+	if (tail != head)
+		return nullptr;
+/* Single element remaining, re-insert the stub behind it to detach. */
+	push (&stub_);
+	next = reinterpret_cast<mpsc_node_t*> (chromium::subtle::Acquire_Load (&tail->next));
+	if (nullptr != next) {
+		tail_ = next;
+		return static_cast<command_t*> (tail);
+	}
+	return nullptr;
+}
+
+/* eof */
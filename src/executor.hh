@@ -0,0 +1,75 @@
+/* Single-writer command executor.
+ *
+ * Commands may be posted from any thread into an intrusive lock-free
+ * multi-producer single-consumer queue (Vyukov), and are executed in post
+ * order by the one thread that owns the target state.  Posting is a single
+ * atomic exchange, executing takes no locks.
+ */
+
+#ifndef __EXECUTOR_HH__
+#define __EXECUTOR_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "chromium/atomicops.hh"
+
+namespace nezumi
+{
+	struct mpsc_node_t
+	{
+		mpsc_node_t() : next (0) {}
+		volatile chromium::subtle::AtomicWord next;
+	};
+
+/* Heap allocated by the producer, deleted by the executor after execute(). */
+	class command_t : public mpsc_node_t
+	{
+	public:
+		virtual ~command_t() {}
+		virtual void execute() = 0;
+	};
+
+	class executor_t :
+		boost::noncopyable
+	{
+	public:
+		executor_t();
+/* Pending commands are deleted without execution. */
+		~executor_t();
+
+/* Any thread, takes ownership of command. */
+		void post (command_t* command);
+
+/* Owner thread only, execute every command visible at entry and return the
+ * count executed.
+ */
+		size_t run();
+
+		uint64_t executed() const { return executed_; }
+		size_t maxBatch() const { return max_batch_; }
+
+	private:
+		void push (mpsc_node_t* node);
+		command_t* pop();
+
+/* Producers exchange onto head, the consumer follows tail. */
+		volatile chromium::subtle::AtomicWord head_;
+		char padding_[64 - sizeof (chromium::subtle::AtomicWord)];
+		mpsc_node_t* tail_;
+		mpsc_node_t stub_;
+
+/* Consumer-side counters. */
+		uint64_t executed_;
+		size_t max_batch_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __EXECUTOR_HH__ */
+
+/* eof */
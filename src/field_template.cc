@@ -0,0 +1,129 @@
+/* Pre-encoded RWF field list with in-place value patching.
+ */
+
+#include "field_template.hh"
+
+#include <cstring>
+
+#include "chromium/logging.hh"
+#include "rwf.hh"
+
+/* Header overhead: flags, info length, u15rb dictionary id, field list number,
+ * and count.
+ */
+static const size_t kFieldListHeaderSize = 1 + 1 + 2 + 2 + 2;
+
+/* Entry overhead: FID and single byte u16ob length. */
+static const size_t kFieldEntryHeaderSize = 2 + 1;
+
+nezumi::field_template_t::field_template_t (
+	uint16_t dictionary_id,
+	int16_t field_list_id
+	) :
+	dictionary_id_ (dictionary_id),
+	field_list_id_ (field_list_id),
+	is_complete_ (false)
+{
+}
+
+unsigned
+nezumi::field_template_t::addUInt (
+	int16_t fid
+	)
+{
+	CHECK(!is_complete_);
+	const field_def_t def = { fid, kUIntSlotWidth, 0 };
+	defs_.push_back (def);
+	return count() - 1;
+}
+
+unsigned
+nezumi::field_template_t::addReal (
+	int16_t fid,
+	uint8_t hint
+	)
+{
+	CHECK(!is_complete_);
+	const field_def_t def = { fid, kRealSlotWidth, hint };
+	defs_.push_back (def);
+	return count() - 1;
+}
+
+void
+nezumi::field_template_t::complete()
+{
+	CHECK(!is_complete_);
+	size_t capacity = kFieldListHeaderSize;
+	for (auto it = defs_.begin(); it != defs_.end(); ++it)
+		capacity += kFieldEntryHeaderSize + it->width;
+	image_.resize (capacity);
+
+	rwf::field_list_encoder_t encoder (image_.data(), image_.size());
+	encoder.init (dictionary_id_, field_list_id_);
+	offsets_.reserve (defs_.size());
+	for (auto it = defs_.begin(); it != defs_.end(); ++it) {
+		const size_t offset = encoder.addFixed (it->fid, it->width);
+		offsets_.push_back (offset);
+/* Real hint is static for the layout. */
+		if (kRealSlotWidth == it->width)
+			image_[offset] = it->hint;
+	}
+	const size_t length = encoder.complete();
+	CHECK_GT(length, 0U);
+	image_.resize (length);
+	is_complete_ = true;
+}
+
+void
+nezumi::field_template_t::write (
+	uint8_t* dst
+	) const
+{
+	DCHECK(is_complete_);
+	memcpy (dst, image_.data(), image_.size());
+}
+
+/* Big-endian store of all eight bytes, no branches on magnitude.
+ */
+static inline
+void
+store64 (
+	uint8_t* dst,
+	uint64_t value
+	)
+{
+	dst[0] = static_cast<uint8_t> (value >> 56);
+	dst[1] = static_cast<uint8_t> (value >> 48);
+	dst[2] = static_cast<uint8_t> (value >> 40);
+	dst[3] = static_cast<uint8_t> (value >> 32);
+	dst[4] = static_cast<uint8_t> (value >> 24);
+	dst[5] = static_cast<uint8_t> (value >> 16);
+	dst[6] = static_cast<uint8_t> (value >> 8);
+	dst[7] = static_cast<uint8_t> (value);
+}
+
+void
+nezumi::field_template_t::setUInt (
+	uint8_t* dst,
+	unsigned slot,
+	uint64_t value
+	) const
+{
+	DCHECK_LT(slot, count());
+	store64 (dst + offsets_[slot], value);
+}
+
+/* Hint byte is static, only the mantissa is patched.
+ */
+void
+nezumi::field_template_t::setReal (
+	uint8_t* dst,
+	unsigned slot,
+	int64_t mantissa
+	) const
+{
+	DCHECK_LT(slot, count());
+	store64 (dst + offsets_[slot] + 1, static_cast<uint64_t> (mantissa));
+}
+
+/* eof */
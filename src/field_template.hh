@@ -0,0 +1,77 @@
+/* Pre-encoded RWF field list with in-place value patching.
+ *
+ * The field list header, entry count and FID headers are encoded once per
+ * field layout, each value is reserved a fixed width slot so that publishing
+ * reduces to a memcpy of the image followed by a store per changed value.
+ * Length-specified RWF integers permit leading sign or zero bytes hence a
+ * padded value decodes identically to a minimally encoded one.
+ *
+ * Encoding is performed by rwf::field_list_encoder_t upon complete().
+ */
+
+#ifndef __FIELD_TEMPLATE_HH__
+#define __FIELD_TEMPLATE_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+namespace nezumi
+{
+	class field_template_t :
+		boost::noncopyable
+	{
+	public:
+/* Fixed widths of value slots including any hint byte. */
+		enum {
+			kUIntSlotWidth	= 8,
+			kRealSlotWidth	= 1 + 8
+		};
+
+		field_template_t (uint16_t dictionary_id, int16_t field_list_id);
+
+/* Append a field definition returning the slot index for patching. */
+		unsigned addUInt (int16_t fid);
+		unsigned addReal (int16_t fid, uint8_t hint);
+
+/* Encode the layout, must be called before any write(). */
+		void complete();
+
+/* Copy encoded image into caller buffer of at least size() bytes. */
+		void write (uint8_t* dst) const;
+
+/* Overwrite slot value within a buffer previously initialised by write(). */
+		void setUInt (uint8_t* dst, unsigned slot, uint64_t value) const;
+		void setReal (uint8_t* dst, unsigned slot, int64_t mantissa) const;
+
+		const uint8_t* data() const { return image_.data(); }
+		size_t size() const { return image_.size(); }
+		unsigned count() const { return static_cast<unsigned> (defs_.size()); }
+
+	private:
+		struct field_def_t {
+			int16_t fid;
+			uint8_t width;
+			uint8_t hint;
+		};
+
+		const uint16_t dictionary_id_;
+		const int16_t field_list_id_;
+/* Field layout in order of addition. */
+		std::vector<field_def_t> defs_;
+/* Encoded field list. */
+		std::vector<uint8_t> image_;
+/* Offset of each value slot within the image. */
+		std::vector<size_t> offsets_;
+		bool is_complete_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __FIELD_TEMPLATE_HH__ */
+
+/* eof */
@@ -0,0 +1,85 @@
+/* Log2 bucketed histogram.
+ */
+
+#include "histogram.hh"
+
+#include <cstring>
+
+void
+nezumi::histogram_t::clear()
+{
+	memset (buckets_, 0, sizeof (buckets_));
+	count_ = sum_ = max_ = 0;
+	min_ = UINT64_MAX;
+}
+
+void
+nezumi::histogram_t::add (
+	uint64_t value
+	)
+{
+	unsigned bucket = 0;
+	for (uint64_t v = value; v > 0 && bucket + 1 < bucket_count; v >>= 1)
+		++bucket;
+	buckets_[bucket]++;
+	count_++;
+	sum_ += value;
+	if (value < min_)
+		min_ = value;
+	if (value > max_)
+		max_ = value;
+}
+
+void
+nezumi::histogram_t::merge (
+	const histogram_t& other
+	)
+{
+	for (unsigned i = 0; i < bucket_count; ++i)
+		buckets_[i] += other.buckets_[i];
+	count_ += other.count_;
+	sum_ += other.sum_;
+	if (other.min_ < min_)
+		min_ = other.min_;
+	if (other.max_ > max_)
+		max_ = other.max_;
+}
+
+uint64_t
+nezumi::histogram_t::percentile (
+	double fraction
+	) const
+{
+	if (0 == count_)
+		return 0;
+	const uint64_t rank = static_cast<uint64_t> (fraction * count_ + 0.5);
+	uint64_t cumulative = 0;
+	for (unsigned i = 0; i < bucket_count; ++i) {
+		cumulative += buckets_[i];
+		if (cumulative >= rank && cumulative > 0) {
+			const uint64_t upper = 0 == i ? 0 : (static_cast<uint64_t> (1) << i) - 1;
+			return upper < max_ ? upper : max_;
+		}
+	}
+	return max_;
+}
+
+std::ostream&
+nezumi::operator<< (
+	std::ostream& o,
+	const histogram_t& histogram
+	)
+{
+	o << "{ "
+		  "\"count\": " << histogram.count() <<
+		", \"min\": " << histogram.minimum() <<
+		", \"mean\": " << histogram.mean() <<
+		", \"p50\": " << histogram.percentile (0.5) <<
+		", \"p99\": " << histogram.percentile (0.99) <<
+		", \"p999\": " << histogram.percentile (0.999) <<
+		", \"max\": " << histogram.maximum() <<
+		" }";
+	return o;
+}
+
+/* eof */
@@ -0,0 +1,50 @@
+/* Log2 bucketed histogram.
+ *
+ * Fixed memory distribution of non-negative samples such as latency in
+ * microseconds, bucket i > 0 holds [2^(i-1), 2^i).  Percentiles resolve to
+ * the bucket upper bound clamped to the observed maximum.  Not thread-safe,
+ * one writer.
+ */
+
+#ifndef __HISTOGRAM_HH__
+#define __HISTOGRAM_HH__
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+namespace nezumi
+{
+	class histogram_t
+	{
+	public:
+		enum { bucket_count = 40 };
+
+		histogram_t() { clear(); }
+
+		void clear();
+		void add (uint64_t value);
+		void merge (const histogram_t& other);
+
+		uint64_t count() const { return count_; }
+		uint64_t minimum() const { return 0 == count_ ? 0 : min_; }
+		uint64_t maximum() const { return max_; }
+		uint64_t mean() const { return 0 == count_ ? 0 : sum_ / count_; }
+/* Fraction in [0, 1], e.g. 0.99 */
+		uint64_t percentile (double fraction) const;
+
+	private:
+		uint64_t buckets_[bucket_count];
+		uint64_t count_;
+		uint64_t sum_;
+		uint64_t min_;
+		uint64_t max_;
+	};
+
+	std::ostream& operator<< (std::ostream& o, const histogram_t& histogram);
+
+} /* namespace nezumi */
+
+#endif /* __HISTOGRAM_HH__ */
+
+/* eof */
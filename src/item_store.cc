@@ -0,0 +1,54 @@
+/* Slab item store with hot and cold state split.
+ */
+
+#include "item_store.hh"
+
+nezumi::item_store_t::item_store_t (
+	unsigned field_count
+	) :
+	field_count_ (field_count),
+	all_fields_ (static_cast<uint8_t> ((1u << field_count) - 1)),
+	values_ (field_count)
+{
+	CHECK_LE(field_count, 8U);
+}
+
+void
+nezumi::item_store_t::reserve (
+	size_t count
+	)
+{
+	tokens_.reserve (count);
+	epochs_.reserve (count);
+	flags_.reserve (count);
+	dirty_.reserve (count);
+	sequences_.reserve (count);
+	for (auto it = values_.begin(); it != values_.end(); ++it)
+		it->reserve (count);
+	names_.reserve (count);
+	index_.reserve (count);
+}
+
+/* New items start pending a refresh with every field marked changed.
+ */
+nezumi::item_store_t::handle_t
+nezumi::item_store_t::insert (
+	const chromium::StringPiece& name
+	)
+{
+	const handle_t handle = static_cast<handle_t> (flags_.size());
+	if (!index_.insert (name, handle))
+		return npos;
+	tokens_.push_back (nullptr);
+	epochs_.push_back (0);
+	flags_.push_back (REFRESH_PENDING_FLAG);
+	dirty_.push_back (all_fields_);
+	sequences_.push_back (0);
+	for (auto it = values_.begin(); it != values_.end(); ++it)
+		it->push_back (0);
+	names_.push_back (rfa::common::RFA_String());
+	names_[handle].set (name.data(), static_cast<unsigned> (name.size()), true);
+	return handle;
+}
+
+/* eof */
@@ -0,0 +1,154 @@
+/* Slab item store with hot and cold state split.
+ *
+ * Items are addressed by a dense handle.  Publish state touched on every
+ * full-universe pass, token, flags, change mask, sequence and field values,
+ * is held as structure-of-arrays such that a pass over one attribute streams
+ * through contiguous memory.  Cold metadata, the RFA name, is held apart.
+ *
+ * Field values are 64-bit words held per field column, record_store_t<>
+ * layers the compile-time field schema over the untyped columns.
+ *
+ * Handles are dense from zero and never recycled, the universe is fixed once
+ * the shards are created such that per-handle arrays sized by capacity() at
+ * creation remain valid.
+ */
+
+#ifndef __ITEM_STORE_HH__
+#define __ITEM_STORE_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+/* RFA 7.2 */
+#include <rfa/rfa.hh>
+
+#include "chromium/logging.hh"
+#include "chromium/string_piece.hh"
+#include "schema.hh"
+#include "symbol_index.hh"
+
+namespace nezumi
+{
+	class item_store_t :
+		boost::noncopyable
+	{
+	public:
+		typedef uint32_t handle_t;
+		enum { npos = symbol_index_t::npos };
+
+/* Hot flag bits. */
+		enum {
+/* Set whenever a new token is issued, the next message on the stream must be
+ * a refresh before any updates are permitted.
+ */
+			REFRESH_PENDING_FLAG	= 0x1
+		};
+
+		explicit item_store_t (unsigned field_count);
+
+		void reserve (size_t count);
+
+/* Returns npos if the symbol is already present. */
+		handle_t insert (const chromium::StringPiece& name);
+		handle_t find (const chromium::StringPiece& name) const { return index_.find (name); }
+
+/* Upper bound of handles for full passes. */
+		size_t capacity() const { return flags_.size(); }
+		size_t size() const { return index_.size(); }
+
+/* Hot state */
+		bool isRefreshPending (handle_t handle) const { return 0 != (flags_[handle] & REFRESH_PENDING_FLAG); }
+		void setRefreshPending (handle_t handle) { flags_[handle] |= REFRESH_PENDING_FLAG; }
+		void clearRefreshPending (handle_t handle) { flags_[handle] &= ~REFRESH_PENDING_FLAG; }
+
+/* Session token which is valid from login success to login close. */
+		rfa::sessionLayer::ItemToken* token (handle_t handle) const { return tokens_[handle]; }
+		void setToken (handle_t handle, rfa::sessionLayer::ItemToken* token) { tokens_[handle] = token; }
+/* Provider login epoch the token was generated within, zero for none. */
+		uint32_t epoch (handle_t handle) const { return epochs_[handle]; }
+		void setEpoch (handle_t handle, uint32_t epoch) { epochs_[handle] = epoch; }
+
+		uint64_t sequence (handle_t handle) const { return sequences_[handle]; }
+		uint64_t nextSequence (handle_t handle) { return ++sequences_[handle]; }
+
+/* Fields modified since last successful publish. */
+		unsigned dirty (handle_t handle) const { return dirty_[handle]; }
+		void clearDirty (handle_t handle) { dirty_[handle] = 0; }
+
+		uint64_t bits (handle_t handle, unsigned field) const {
+			DCHECK_LT(field, field_count_);
+			return values_[field][handle];
+		}
+		void setBits (handle_t handle, unsigned field, uint64_t bits) {
+			DCHECK_LT(field, field_count_);
+			uint64_t& value = values_[field][handle];
+			if (bits == value) return;
+			value = bits;
+			dirty_[handle] |= 1u << field;
+		}
+
+/* Cold state */
+		const rfa::common::RFA_String& name (handle_t handle) const { return names_[handle]; }
+
+	private:
+		const unsigned field_count_;
+		const uint8_t all_fields_;
+
+		std::vector<rfa::sessionLayer::ItemToken*> tokens_;
+		std::vector<uint32_t> epochs_;
+		std::vector<uint8_t> flags_;
+		std::vector<uint8_t> dirty_;
+		std::vector<uint64_t> sequences_;
+		std::vector<std::vector<uint64_t>> values_;
+
+		std::vector<rfa::common::RFA_String> names_;
+
+		symbol_index_t index_;
+	};
+
+/* Typed access to the value columns by record schema. */
+	template <class Record>
+	class record_store_t : public item_store_t
+	{
+	public:
+		typedef schema::record_encoder_t<Record> encoder_type;
+
+/* Read-only view of one item for record_encoder_t<>. */
+		class view_t
+		{
+		public:
+			view_t (const item_store_t& store, handle_t handle) : store_ (store), handle_ (handle) {}
+			uint64_t bits (unsigned field) const { return store_.bits (handle_, field); }
+		private:
+			const item_store_t& store_;
+			const handle_t handle_;
+		};
+
+		record_store_t() :
+			item_store_t (encoder_type::size)
+		{
+		}
+
+		template <class Field>
+		void set (handle_t handle, typename Field::value_type value) {
+			setBits (handle, schema::index_of<Record, Field>::value, Field::type::to_bits (value));
+		}
+
+		template <class Field>
+		typename Field::value_type get (handle_t handle) const {
+			return Field::type::from_bits (bits (handle, schema::index_of<Record, Field>::value));
+		}
+
+		view_t record (handle_t handle) const { return view_t (*this, handle); }
+	};
+
+} /* namespace nezumi */
+
+#endif /* __ITEM_STORE_HH__ */
+
+/* eof */
@@ -10,6 +10,7 @@
 
 #pragma comment (lib, "winmm")
 
+#include "chromium/binary_log.hh"
 #include "chromium/command_line.hh"
 #include "chromium/logging.hh"
 
@@ -33,6 +34,17 @@ public:
 			logging::ENABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS
 			);
 		logging::SetLogMessageHandler (log_handler);
+/* console and file output from a writer thread, never the caller. */
+		logging::StartAsyncLogging();
+/* BLOG records are rendered on a decoder thread. */
+		logging::StartBinaryLogging();
+	}
+
+	~env_t()
+	{
+		logging::StopBinaryLogging();
+		logging::LogSuppressedMessages();
+		logging::StopAsyncLogging();
 	}
 
 protected:
@@ -0,0 +1,41 @@
+/* Published MarketPrice record schema.
+ *
+ * Free of RFA such that benchmarks measure the same record as the shards.
+ */
+
+#ifndef __MARKET_PRICE_HH__
+#define __MARKET_PRICE_HH__
+#pragma once
+
+/* Boost type sequences. */
+#include <boost/mpl/vector.hpp>
+
+#include "rwf.hh"
+#include "schema.hh"
+
+namespace nezumi
+{
+/* Fields are encoded in declaration order. */
+	struct market_price_t
+	{
+/* RDM Field Identifiers. */
+		typedef schema::field<2, schema::uint_type> RDNDISPLAY;
+		typedef schema::field<6, schema::real_type<rwf::EXPONENT0> > TRDPRC_1;
+		typedef boost::mpl::vector<RDNDISPLAY, TRDPRC_1> fields;
+
+		enum {
+/* RDM Usage Guide: Section 6.5: Enterprise Platform
+ * For future compatibility, the DictionaryId should be set to 1 by providers.
+ * The DictionaryId for the RDMFieldDictionary is 1.
+ */
+			dictionary_id	= 1,
+/* RDM: Absolutely no idea. */
+			field_list_id	= 3
+		};
+	};
+
+} /* namespace nezumi */
+
+#endif /* __MARKET_PRICE_HH__ */
+
+/* eof */
@@ -106,6 +106,41 @@ namespace ms
  */
 	typedef unique_handle<HANDLE, handle_traits> handle;
 
+/* CreateFile signals failure with INVALID_HANDLE_VALUE rather than NULL. */
+	struct file_handle_traits
+	{
+		static HANDLE invalid() throw()
+		{
+			return INVALID_HANDLE_VALUE;
+		}
+ 
+		static void close(HANDLE value) throw()
+		{
+			CloseHandle (value);
+		}
+	};
+
+	typedef unique_handle<HANDLE, file_handle_traits> file_handle;
+
+	struct map_view_traits
+	{
+		static const void* invalid() throw()
+		{
+			return nullptr;
+		}
+ 
+		static void close(const void* value) throw()
+		{
+			UnmapViewOfFile (value);
+		}
+	};
+
+/* Example usage:
+ *
+ * map_view v (MapViewOfFile (...));
+ */
+	typedef unique_handle<const void*, map_view_traits> map_view;
+
 } /* namespace ms */
 
 #endif /* __MS_UNIQUE_HANDLE_HH__ */
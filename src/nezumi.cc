@@ -11,21 +11,11 @@
 
 #include "chromium/logging.hh"
 #include "error.hh"
+#include "rfa.hh"
 #include "rfa_logging.hh"
 #include "rfaostream.hh"
-
-/* RDM Usage Guide: Section 6.5: Enterprise Platform
- * For future compatibility, the DictionaryId should be set to 1 by providers.
- * The DictionaryId for the RDMFieldDictionary is 1.
- */
-static const int kDictionaryId = 1;
-
-/* RDM: Absolutely no idea. */
-static const int kFieldListId = 3;
-
-/* RDM Field Identifiers. */
-static const int kRdmRdnDisplayId = 2;		/* RDNDISPLAY */
-static const int kRdmTradePriceId = 6;		/* TRDPRC_1 */
+#include "symbol_index.hh"
+#include "universe.hh"
 
 using rfa::common::RFA_String;
 
@@ -60,19 +50,51 @@ nezumi::nezumi_t::run ()
 		if (!(bool)log_ || !log_->Register())
 			goto cleanup;
 
-/* RFA provider. */
-		provider_.reset (new provider_t (config_, rfa_, event_queue_));
-		if (!(bool)provider_ || !provider_->init())
+/* Publishing shards. */
+		if (0 == config_.shard_count) {
+			LOG(ERROR) << "Shard count must be at least one.";
 			goto cleanup;
-
-/* Create state for published RIC. */
-		static const std::string msft ("MSFT.O");
-		auto stream = std::make_shared<broadcast_stream_t> ();
-		if (!(bool)stream)
+		}
+		if (0 == config_.timer_resolution_us) {
+			LOG(ERROR) << "Timer resolution must be at least one microsecond.";
 			goto cleanup;
-		if (!provider_->createItemStream (msft.c_str(), stream))
+		}
+		if (!parse_catchup_policy (config_.timer_catchup, &catchup_policy_)) {
+			LOG(ERROR) << "Unknown timer catch-up policy \"" << config_.timer_catchup << "\".";
+			goto cleanup;
+		}
+		if (config_.simulation_seconds > 0 && config_.reactor_mode) {
+			LOG(ERROR) << "Simulation requires the timer thread, disable reactor mode.";
+			goto cleanup;
+		}
+		for (size_t i = 0; i < config_.shard_count; ++i) {
+			std::unique_ptr<shard_t> shard (new shard_t (i, config_, rfa_));
+			if (!(bool)shard || !shard->init())
+				goto cleanup;
+			shards_.push_back (std::move (shard));
+		}
+
+/* Create state for published RICs. */
+		if (!createItemStreams())
 			goto cleanup;
-		msft_stream_ = std::move (stream);
+
+/* Shard threads take over their event queues from here. */
+		origin_ = boost::chrono::system_clock::now();
+		for (auto it = shards_.begin(); it != shards_.end(); ++it) {
+			if (!(*it)->start (origin_))
+				goto cleanup;
+		}
+
+		if (config_.watchdog_threshold_ms > 0) {
+			watchdog_.reset (new watchdog_t (config_.watchdog_threshold_ms));
+			if (!(bool)watchdog_)
+				goto cleanup;
+			for (auto it = shards_.begin(); it != shards_.end(); ++it)
+				watchdog_->add (&(*it)->monitor());
+			if (!watchdog_->start())
+				goto cleanup;
+			LOG(INFO) << "Watchdog stall threshold " << config_.watchdog_threshold_ms << "ms.";
+		}
 
 	} catch (rfa::common::InvalidUsageException& e) {
 		LOG(ERROR) << "InvalidUsageException: { "
@@ -90,15 +112,38 @@ nezumi::nezumi_t::run ()
 		goto cleanup;
 	}
 
-/* Timer for demo periodic publishing of items.
- */
-	timer_.reset (new time_pump_t<boost::chrono::system_clock> (boost::chrono::system_clock::now(), boost::chrono::seconds (1), this));
-	if (!(bool)timer_)
-		goto cleanup;
-	timer_thread_.reset (new boost::thread (*timer_.get()));
-	if (!(bool)timer_thread_)
-		goto cleanup;
-	LOG(INFO) << "Added periodic timer, interval " << boost::chrono::seconds (1).count() << " seconds";
+/* Timer turning the publish schedule of every shard, item intervals are
+ * multiples of the timer resolution.  Reactor shards keep their own.
+ */
+	if (config_.reactor_mode) {
+		LOG(INFO) << "Reactor mode, shard timers interval " << config_.timer_resolution_us << "us"
+			", spin " << config_.timer_spin_us << "us.";
+	} else if (config_.simulation_seconds > 0) {
+/* Virtual time line starts at the shard origin. */
+		const boost::chrono::microseconds resolution (config_.timer_resolution_us);
+		const virtual_clock_t::time_point origin (boost::chrono::duration_cast<virtual_clock_t::duration> (origin_.time_since_epoch()));
+		virtual_clock_t::reset (origin);
+		virtual_timer_.reset (new time_pump_t<virtual_clock_t> (origin, resolution, catchup_policy_, boost::chrono::microseconds (0), this));
+		if (!(bool)virtual_timer_)
+			goto cleanup;
+		timer_thread_.reset (new boost::thread (*virtual_timer_.get()));
+		if (!(bool)timer_thread_)
+			goto cleanup;
+		LOG(INFO) << "Simulating " << config_.simulation_seconds << "s on a virtual clock"
+			", interval " << resolution.count() << "us.";
+	} else {
+		const boost::chrono::microseconds resolution (config_.timer_resolution_us);
+		const boost::chrono::microseconds spin (config_.timer_spin_us);
+		timer_.reset (new time_pump_t<boost::chrono::system_clock> (origin_, resolution, catchup_policy_, spin, this));
+		if (!(bool)timer_)
+			goto cleanup;
+		timer_thread_.reset (new boost::thread (*timer_.get()));
+		if (!(bool)timer_thread_)
+			goto cleanup;
+		LOG(INFO) << "Added periodic timer, interval " << resolution.count() << "us"
+			", spin " << spin.count() << "us"
+			", catch-up " << catchup_policy_string (catchup_policy_);
+	}
 
 	LOG(INFO) << "Init complete, entering main loop.";
 	mainLoop ();
@@ -153,8 +198,9 @@ nezumi::nezumi_t::mainLoop()
 {
 /* Add shutdown handler. */
 	::SetConsoleCtrlHandler ((PHANDLER_ROUTINE)::CtrlHandler, TRUE);
-	while (event_queue_->isActive()) {
-		event_queue_->dispatch (rfa::common::Dispatchable::InfiniteWait);
+/* Application events only, publishing runs on the shard threads. */
+	while (event_queue_->isActive()) {
+		event_queue_->dispatch (rfa::common::Dispatchable::InfiniteWait);
 	}
 /* Remove shutdown handler. */
 	::SetConsoleCtrlHandler ((PHANDLER_ROUTINE)::CtrlHandler, FALSE);
@@ -170,16 +216,21 @@ nezumi::nezumi_t::clear()
 	}	
 	timer_thread_.reset();
 	timer_.reset();
+	virtual_timer_.reset();
 
 /* Signal message pump thread to exit. */
 	if ((bool)event_queue_)
 		event_queue_->deactivate();
 
-	msft_stream_.reset();
+/* Monitors are owned by the shards. */
+	watchdog_.reset();
+
+/* Stop and release every shard before the shared RFA context. */
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		(*it)->stop();
+	shards_.clear();
 
 /* Release everything with an RFA dependency. */
-	assert (provider_.use_count() <= 1);
-	provider_.reset();
 	assert (log_.use_count() <= 1);
 	log_.reset();
 	assert (event_queue_.use_count() <= 1);
@@ -188,124 +239,107 @@ nezumi::nezumi_t::clear()
 	rfa_.reset();
 }
 
+/* Timer thread: touch no shard state, only post.
+ */
 bool
 nezumi::nezumi_t::processTimer (
 	const boost::chrono::time_point<boost::chrono::system_clock>& t
 	)
 {
-/* calculate timer accuracy, typically 15-1ms with default timer resolution.
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		(*it)->processTimer (t);
+/* continue raising timer events */
+	return true;
+}
+
+/* Lock-step: a tick is complete on every shard before the next is stamped,
+ * and the time line holds at its origin until every shard has logged in,
+ * such that shard output depends on virtual time alone and not on the
+ * latency of the ADH login.
  */
-	if (DLOG_IS_ON(INFO)) {
-		using namespace boost::chrono;
-		auto now = system_clock::now();
-		auto ms = duration_cast<milliseconds> (now - t);
-		if (0 == ms.count()) {
-			LOG(INFO) << "delta " << duration_cast<microseconds> (now - t).count() << "us";
-		} else {
-			LOG(INFO) << "delta " << ms.count() << "ms";
-		}
+bool
+nezumi::nezumi_t::processTimer (
+	const boost::chrono::time_point<virtual_clock_t>& t
+	)
+{
+	using namespace boost::chrono;
+	const time_point<system_clock> now (duration_cast<system_clock::duration> (t.time_since_epoch()));
+	if (now - origin_ >= seconds (config_.simulation_seconds)) {
+		LOG(INFO) << "Simulation complete.";
+		event_queue_->deactivate();
+		return false;
 	}
-
-	try {
-		sendRefresh();
-	} catch (rfa::common::InvalidUsageException& e) {
-		LOG(ERROR) << "InvalidUsageException: { "
-			  "\"Severity\": \"" << severity_string (e.getSeverity()) << "\""
-			", \"Classification\": \"" << classification_string (e.getClassification()) << "\""
-			", \"StatusText\": \"" << e.getStatus().getStatusText() << "\" }";
+	for (auto it = shards_.begin(); it != shards_.end(); ++it) {
+		while (!(*it)->hasLoggedIn())
+			boost::this_thread::sleep_for (milliseconds (1));
+	}
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		(*it)->processTimer (now);
+	for (auto it = shards_.begin(); it != shards_.end(); ++it) {
+		while ((*it)->ticksInFlight() > 0) {
+			boost::this_thread::interruption_point();
+			boost::this_thread::yield();
+		}
 	}
-/* continue raising timer events */
 	return true;
 }
 
+/* Load the symbol universe and create every item stream in one pass, the
+ * shard of a symbol is a stable hash of the RIC such that placement does not
+ * change between runs with the same shard count.
+ */
 bool
-nezumi::nezumi_t::sendRefresh()
+nezumi::nezumi_t::createItemStreams()
 {
-/* 7.5.9.1 Create a response message (4.2.2) */
-	rfa::message::RespMsg response (false);	/* reference */
-
-/* 7.5.9.2 Set the message model type of the response. */
-	response.setMsgModelType (rfa::rdm::MMT_MARKET_PRICE);
-/* 7.5.9.3 Set response type. */
-	response.setRespType (rfa::message::RespMsg::RefreshEnum);
-	response.setIndicationMask (rfa::message::RespMsg::RefreshCompleteFlag);
-/* 7.5.9.4 Set the response type enumation. */
-	response.setRespTypeNum (rfa::rdm::REFRESH_UNSOLICITED);
-
-/* 7.5.9.5 Create or re-use a request attribute object (4.2.4) */
-	rfa::message::AttribInfo attribInfo (false);	/* reference */
-	attribInfo.setNameType (rfa::rdm::INSTRUMENT_NAME_RIC);
-	RFA_String service_name (config_.service_name.c_str(), 0, false);	/* reference */
-	attribInfo.setName (msft_stream_->rfa_name);
-	LOG(INFO) << "Publishing to stream " << msft_stream_->rfa_name;
-	attribInfo.setServiceName (service_name);
-	response.setAttribInfo (attribInfo);
-
-/* 4.3.1 RespMsg.Payload */
-/* 6.2.8 Quality of Service. */
-	rfa::common::QualityOfService QoS;
-/* Timeliness: age of data, either real-time, unspecified delayed timeliness,
- * unspecified timeliness, or any positive number representing the actual
- * delay in seconds.
- */
-	QoS.setTimeliness (rfa::common::QualityOfService::realTime);
-/* Rate: minimum period of change in data, either tick-by-tick, just-in-time
- * filtered rate, unspecified rate, or any positive number representing the
- * actual rate in milliseconds.
- */
-	QoS.setRate (rfa::common::QualityOfService::tickByTick);
-	response.setQualityOfService (QoS);
-
-// not std::map :(  derived from rfa::common::Data
-	fields_.setAssociatedMetaInfo (provider_->getRwfMajorVersion(), provider_->getRwfMinorVersion());
-	fields_.setInfo (kDictionaryId, kFieldListId);
-
-	rfa::data::FieldListWriteIterator it;
-	it.start (fields_);
-
-	rfa::data::FieldEntry field (true);
-	rfa::data::DataBuffer dataBuffer (true);
-	rfa::data::Real64 real64;
-
-	field.setFieldID (kRdmRdnDisplayId);
-	dataBuffer.setUInt32 (100);
-	field.setData (dataBuffer), it.bind (field);
-
-	field.setFieldID (kRdmTradePriceId);
-	real64.setValue (++msft_stream_->count);
-	real64.setMagnitudeType (rfa::data::Exponent0);
-	dataBuffer.setReal64 (real64);
-	field.setData (dataBuffer), it.bind (field);
-
-	it.complete();
-/* Set a reference to field list, not a copy */
-	response.setPayload (fields_);
-
-	rfa::common::RespStatus status;
-/* Item interaction state: Open, Closed, ClosedRecover, Redirected, NonStreaming, or Unspecified. */
-	status.setStreamState (rfa::common::RespStatus::OpenEnum);
-/* Data quality state: Ok, Suspect, or Unspecified. */
-	status.setDataState (rfa::common::RespStatus::OkEnum);
-/* Error code, e.g. NotFound, InvalidArgument, ... */
-	status.setStatusCode (rfa::common::RespStatus::NoneEnum);
-	response.setRespStatus (status);
-
-#ifdef DEBUG
-/* 4.2.8 Message Validation.  RFA provides an interface to verify that
- * constructed messages of these types conform to the Reuters Domain
- * Models as specified in RFA API 7 RDM Usage Guide.
- */
-	RFA_String warningText;
-	const uint8_t validation_status = response.validateMsg (&warningText);
-	if (rfa::message::MsgValidationWarning == validation_status) {
-		LOG(ERROR) << "respMsg::validateMsg: { \"warningText\": \"" << warningText << "\" }";
-	} else {
-		assert (rfa::message::MsgValidationOk == validation_status);
+	using namespace boost::chrono;
+	const steady_clock::time_point start = steady_clock::now();
+
+	static const chromium::StringPiece msft ("MSFT.O");
+	const std::vector<chromium::StringPiece> default_names (1, msft);
+	const std::vector<uint32_t> default_intervals (1, 0);
+	universe_t universe;
+	const std::vector<chromium::StringPiece>* names = &default_names;
+	const std::vector<uint32_t>* intervals = &default_intervals;
+	if (!config_.universe_path.empty()) {
+		if (!universe.open (config_.universe_path.c_str()))
+			return false;
+		names = &universe.symbols();
+		intervals = &universe.intervals();
+		if (names->empty()) {
+			LOG(ERROR) << "No symbols found in universe \"" << config_.universe_path << "\".";
+			return false;
+		}
+	}
+	const size_t count = names->size();
+	const steady_clock::time_point loaded = steady_clock::now();
+
+	const size_t shard_count = shards_.size();
+	std::vector<std::vector<chromium::StringPiece>> partitions (shard_count);
+	std::vector<std::vector<uint32_t>> partition_intervals (shard_count);
+	for (size_t i = 0; i < shard_count; ++i) {
+		partitions[i].reserve (count / shard_count + 1);
+		partition_intervals[i].reserve (count / shard_count + 1);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		const chromium::StringPiece& name = (*names)[i];
+		const size_t shard = symbol_shard (symbol_hash (name.data(), name.size()), shard_count);
+		partitions[shard].push_back (name);
+		partition_intervals[shard].push_back ((*intervals)[i]);
+	}
+	for (size_t i = 0; i < shard_count; ++i) {
+		if (!shards_[i]->createItemStreams (partitions[i], partition_intervals[i]))
+			return false;
+		LOG(INFO) << "Shard " << i << ": " << shards_[i]->size() << " item streams.";
 	}
-#endif
 
-	provider_->send (*msft_stream_.get(), static_cast<rfa::common::Msg&> (response));
-	LOG(INFO) << "Sent refresh.";
+/* Startup timing, see bench/startup_bench.cc for the benchmark. */
+	const steady_clock::time_point created = steady_clock::now();
+	const milliseconds load_ms = duration_cast<milliseconds> (loaded - start);
+	const milliseconds create_ms = duration_cast<milliseconds> (created - loaded);
+	const double seconds = duration_cast<duration<double>> (created - start).count();
+	VLOG(1) << "Created " << count << " item streams in " << (load_ms + create_ms).count() << "ms"
+		" (load " << load_ms.count() << "ms, create " << create_ms.count() << "ms"
+		", " << static_cast<uint64_t> (seconds > 0 ? count / seconds : 0) << " items/s).";
 	return true;
 }
 
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 /* Boost Chrono. */
 #include <boost/chrono.hpp>
@@ -28,8 +29,12 @@
 
 #include "chromium/logging.hh"
 
+#include "clock.hh"
 #include "config.hh"
-#include "provider.hh"
+#include "histogram.hh"
+#include "shard.hh"
+#include "time_pump.hh"
+#include "watchdog.hh"
 
 namespace logging
 {
@@ -39,62 +44,10 @@ namespace logging
 namespace nezumi
 {
 	class rfa_t;
-	class provider_t;
-
-/* Basic example structure for application state of an item stream. */
-	class broadcast_stream_t : public item_stream_t
-	{
-	public:
-		broadcast_stream_t () :
-			count (0)
-		{
-		}
-
-		uint64_t	count;
-	};
-
-/* Periodic timer event source */
-	template<class Clock, class Duration = typename Clock::duration>
-	class time_base_t
-	{
-	public:
-		virtual bool processTimer (const boost::chrono::time_point<Clock, Duration>& t) = 0;
-	};
-
-	template<class Clock, class Duration = typename Clock::duration>
-	class time_pump_t
-	{
-	public:
-		time_pump_t (const boost::chrono::time_point<Clock, Duration>& due_time, Duration td, time_base_t<Clock, Duration>* cb) :
-			due_time_ (due_time),
-			td_ (td),
-			cb_ (cb)
-		{
-			CHECK(nullptr != cb_);
-		}
-
-		void operator()()
-		{
-			try {
-				while (true) {
-					boost::this_thread::sleep_until (due_time_);
-					if (!cb_->processTimer (due_time_))
-						break;
-					due_time_ += td_;
-				}
-			} catch (boost::thread_interrupted const&) {
-				LOG(INFO) << "Timer thread interrupted.";
-			}
-		}
-
-	private:
-		boost::chrono::time_point<Clock, Duration> due_time_;
-		Duration td_;
-		time_base_t<Clock, Duration>* cb_;
-	};
 
 	class nezumi_t :
 		public time_base_t<boost::chrono::system_clock>,
+		public time_base_t<virtual_clock_t>,
 		boost::noncopyable
 	{
 	public:
@@ -106,40 +59,45 @@ namespace nezumi
 		int run();
 		void clear();
 
-/* Configured period timer entry point. */
+/* Configured period timer entry point, forwards to every shard thread. */
 		bool processTimer (const boost::chrono::time_point<boost::chrono::system_clock>& t) override;
+/* Simulation timer entry point, returns once every shard has run the tick. */
+		bool processTimer (const boost::chrono::time_point<virtual_clock_t>& t) override;
 
 	private:
-
 /* Run core event loop. */
 		void mainLoop();
 
-/* Broadcast out message. */
-		bool sendRefresh() throw (rfa::common::InvalidUsageException);
+/* Partition the configured symbol universe across shards and create all
+ * item streams.
+ */
+		bool createItemStreams();
 
 /* Application configuration. */
 		config_t config_;
+		catchup_policy_t catchup_policy_;
 
 /* RFA context. */
 		std::shared_ptr<rfa_t> rfa_;
 
-/* RFA asynchronous event queue. */
+/* RFA asynchronous event queue for application events, shutdown and logging. */
 		std::shared_ptr<rfa::common::EventQueue> event_queue_;
 
 /* RFA logging */
 		std::shared_ptr<logging::LogEventProvider> log_;
 
-/* RFA provider */
-		std::shared_ptr<provider_t> provider_;
-	
-/* Item stream. */
-		std::shared_ptr<broadcast_stream_t> msft_stream_;
+/* Publishing shards, each with a session, provider and thread. */
+		std::vector<std::unique_ptr<shard_t>> shards_;
+
+/* Stall detection across shard threads. */
+		std::unique_ptr<watchdog_t> watchdog_;
 
-/* Publish fields. */
-		rfa::data::FieldList fields_;
+/* Tick zero of the timer and every shard. */
+		boost::chrono::time_point<boost::chrono::system_clock> origin_;
 
-/* Thread timer. */
+/* Thread timer, on the virtual clock when simulating. */
 		std::unique_ptr<time_pump_t<boost::chrono::system_clock>> timer_;
+		std::unique_ptr<time_pump_t<virtual_clock_t>> virtual_timer_;
 		std::unique_ptr<boost::thread> timer_thread_;
 	};
 
@@ -12,6 +12,7 @@
 
 #include <windows.h>
 
+#include "chromium/binary_log.hh"
 #include "chromium/logging.hh"
 #include "error.hh"
 #include "rfaostream.hh"
@@ -30,7 +31,9 @@ static const RFA_String kEnumTypeDictionaryName ("RWFEnum");
 nezumi::provider_t::provider_t (
 	const nezumi::config_t& config,
 	std::shared_ptr<nezumi::rfa_t> rfa,
-	std::shared_ptr<rfa::common::EventQueue> event_queue
+	std::shared_ptr<rfa::common::EventQueue> event_queue,
+	nezumi::item_store_t& items,
+	nezumi::loop_monitor_t* monitor
 	) :
 	config_ (config),
 	rfa_ (rfa),
@@ -39,7 +42,10 @@ nezumi::provider_t::provider_t (
 	item_handle_ (nullptr),
 	rwf_major_version_ (0),
 	rwf_minor_version_ (0),
-	is_muted_ (true)
+	is_muted_ (true),
+	token_epoch_ (0),
+	items_ (items),
+	monitor_ (monitor)
 {
 	ZeroMemory (cumulative_stats_, sizeof (cumulative_stats_));
 	ZeroMemory (snap_stats_, sizeof (snap_stats_));
@@ -194,64 +200,72 @@ nezumi::provider_t::sendLoginRequest()
 	return true;
 }
 
-/* Create an item stream for a given symbol name.  The Item Stream maintains
- * the provider state on behalf of the application.
- */
 bool
-nezumi::provider_t::createItemStream (
-	const char* name,
-	std::shared_ptr<item_stream_t> item_stream
+nezumi::provider_t::createItemStreams (
+	const std::vector<chromium::StringPiece>& names
 	)
 {
-	VLOG(4) << "Creating item stream for RIC \"" << name << "\".";
-	item_stream->rfa_name.set (name, 0, true);
-	if (!is_muted_) {
-		DVLOG(4) << "Generating token for " << name;
-		item_stream->token = &( omm_provider_->generateItemToken() );
-		assert (nullptr != item_stream->token);
-		cumulative_stats_[PROVIDER_PC_TOKENS_GENERATED]++;
-	} else {
-		DVLOG(4) << "Not generating token for " << name << " as provider is muted.";
-		assert (nullptr == item_stream->token);
+	VLOG(2) << "Creating " << names.size() << " item streams.";
+	items_.reserve (items_.size() + names.size());
+	for (auto it = names.begin(); it != names.end(); ++it) {
+		const item_store_t::handle_t handle = items_.insert (*it);
+		if (item_store_t::npos == handle) {
+			LOG(ERROR) << "Duplicate symbol \"" << *it << "\" in item stream set.";
+			return false;
+		}
 	}
-	const std::string key (name);
-	auto status = directory_.emplace (std::make_pair (key, item_stream));
-	assert (true == status.second);
-	assert (directory_.end() != directory_.find (key));
-	DVLOG(4) << "Directory size: " << directory_.size();
+	DVLOG(4) << "Directory size: " << items_.size();
 	last_activity_ = boost::posix_time::microsec_clock::universal_time();
 	return true;
 }
 
-/* Send an Rfa message through the pre-created item stream.
+/* Tokens are regenerated lazily, recovery after login costs only the items
+ * actually published rather than a sweep of the universe.
  */
-
 bool
-nezumi::provider_t::send (
-	item_stream_t& item_stream,
-	rfa::common::Msg& msg
-)
+nezumi::provider_t::acquireToken (
+	item_store_t::handle_t handle
+	)
 {
 	if (is_muted_)
 		return false;
-	assert (nullptr != item_stream.token);
-	send (msg, *item_stream.token, nullptr);
-	cumulative_stats_[PROVIDER_PC_MSGS_SENT]++;
-	last_activity_ = boost::posix_time::microsec_clock::universal_time();
+	const uint32_t epoch = static_cast<uint32_t> (chromium::subtle::Acquire_Load (&token_epoch_));
+	if (epoch == items_.epoch (handle))
+		return true;
+	items_.setToken (handle, &( omm_provider_->generateItemToken() ));
+	assert (nullptr != items_.token (handle));
+	items_.setEpoch (handle, epoch);
+/* New token implies a new stream at the ADH, consumers require a fresh image. */
+	items_.setRefreshPending (handle);
+	cumulative_stats_[PROVIDER_PC_TOKENS_GENERATED]++;
 	return true;
 }
 
-uint32_t
-nezumi::provider_t::send (
-	rfa::common::Msg& msg,
-	rfa::sessionLayer::ItemToken& token,
-	void* closure
+/* Mute state and clock are sampled once and one item command is re-used,
+ * tokens must already be acquired for the current login.
+ */
+bool
+nezumi::provider_t::sendBatch (
+	const outbound_msg_t* batch,
+	size_t count
 	)
 {
 	if (is_muted_)
 		return false;
-
-	return submit (msg, token, closure);
+	assert ((bool)omm_provider_);
+	DCHECK(nullptr != batch || 0 == count);
+#ifndef NDEBUG
+	for (size_t i = 0; i < count; ++i) {
+		assert (nullptr != items_.token (batch[i].handle));
+		assert (items_.epoch (batch[i].handle) == static_cast<uint32_t> (token_epoch_));
+	}
+#endif
+	submit_span (*omm_provider_, items_, batch, count);
+	cumulative_stats_[PROVIDER_PC_MSGS_SENT] += static_cast<uint32_t> (count);
+	cumulative_stats_[PROVIDER_PC_RFA_MSGS_SENT] += static_cast<uint32_t> (count);
+	cumulative_stats_[PROVIDER_PC_BATCHES_SENT]++;
+	last_activity_ = boost::posix_time::microsec_clock::universal_time();
+	return true;
 }
 
 /* 7.5.9.6 Create the OMMItemCmd object and populate it with the response
@@ -283,6 +297,7 @@ nezumi::provider_t::processEvent (
 	const rfa::common::Event& event_
 	)
 {
+	loop_monitor_t::callback_scope_t scope (monitor_);
 	VLOG(1) << event_;
 	cumulative_stats_[PROVIDER_PC_RFA_EVENTS_RECEIVED]++;
 	switch (event_.getType()) {
@@ -686,27 +701,21 @@ nezumi::provider_t::getServiceState (
 	it.complete();
 }
 
-/* Iterate through entire item dictionary and re-generate tokens.
- */
+/* Invalidate every item token by advancing the epoch, constant time
+ * irrespective of universe size.  Each item regenerates within
+ * acquireToken().
+ */
 bool
 nezumi::provider_t::resetTokens()
 {
-	if (!(bool)omm_provider_) {
-		LOG(WARNING) << "Reset tokens whilst provider is invalid.";
-		return false;
-	}
+	if (!(bool)omm_provider_) {
+		LOG(WARNING) << "Reset tokens whilst provider is invalid.";
+		return false;
+	}
 
-	LOG(INFO) << "Resetting " << directory_.size() << " provider tokens.";
-/* Cannot use std::for_each (auto λ) due to language limitations. */
-	std::for_each (directory_.begin(), directory_.end(),
-		[&](std::pair<std::string, std::weak_ptr<item_stream_t>> it)
-	{
-		if (auto sp = it.second.lock()) {
-			sp->token = &( omm_provider_->generateItemToken() );
-			assert (nullptr != sp->token);
-			cumulative_stats_[PROVIDER_PC_TOKENS_GENERATED]++;
-		}
-	});
+	const uint32_t epoch = static_cast<uint32_t> (token_epoch_) + 1;
+	LOG(INFO) << "Resetting " << items_.size() << " provider tokens, epoch " << epoch << ".";
+	chromium::subtle::Release_Store (&token_epoch_, static_cast<chromium::subtle::Atomic32> (epoch));
 	return true;
 }
 
@@ -749,12 +758,16 @@ nezumi::provider_t::processOMMCmdErrorEvent (
 	)
 {
 	cumulative_stats_[PROVIDER_PC_OMM_CMD_ERRORS]++;
-	LOG(ERROR) << "OMMCmdErrorEvent: { "
-		  "\"CmdId\": " << error.getCmdID() <<
-		", \"State\": " << error.getStatus().getState() <<
-		", \"StatusCode\": " << error.getStatus().getStatusCode() <<
-		", \"StatusText\": \"" << error.getStatus().getStatusText() << "\""
-		" }";
+	BLOG_EVERY_T_SUMMARY(ERROR, 1, "OMMCmdErrorEvent: { "
+		  "\"CmdId\": {}"
+		", \"State\": {}"
+		", \"StatusCode\": {}"
+		", \"StatusText\": \"{}\""
+		" }") (
+		error.getCmdID(),
+		static_cast<int> (error.getStatus().getState()),
+		static_cast<int> (error.getStatus().getStatusCode()),
+		error.getStatus().getStatusText().c_str());
 }
 
 /* eof */
@@ -6,7 +6,7 @@
 #pragma once
 
 #include <cstdint>
-#include <unordered_map>
+#include <vector>
 
 /* Boost Posix Time */
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -17,9 +17,14 @@
 /* RFA 7.2 */
 #include <rfa/rfa.hh>
 
+#include "chromium/atomicops.hh"
+#include "chromium/string_piece.hh"
+
 #include "rfa.hh"
 #include "config.hh"
 #include "deleter.hh"
+#include "item_store.hh"
+#include "watchdog.hh"
 
 namespace nezumi
 {
@@ -46,36 +51,59 @@ namespace nezumi
 		PROVIDER_PC_MMT_DIRECTORY_MALFORMED,
 		PROVIDER_PC_MMT_DIRECTORY_SENT,
 		PROVIDER_PC_TOKENS_GENERATED,
+		PROVIDER_PC_BATCHES_SENT,
 /* marker */
 		PROVIDER_PC_MAX
 	};
 
-	class item_stream_t : boost::noncopyable
+/* One message of a publish batch, the message references its payload. */
+	struct outbound_msg_t
 	{
-	public:
-		item_stream_t () :
-			token (nullptr)
-		{
-		}
-
-/* Fixed name for this stream. */
-		rfa::common::RFA_String rfa_name;
-/* Session token which is valid from login success to login close. */
-		rfa::sessionLayer::ItemToken* token;
+		item_store_t::handle_t handle;
+		rfa::common::Msg* msg;
 	};
 
+/* Submit loop of provider_t::sendBatch(), one item command is re-used for
+ * the span.  Templated on the OMM provider for bench/submit_bench.cc.
+ */
+	template <class OMMProvider>
+	void submit_span (OMMProvider& omm_provider, const item_store_t& items, const outbound_msg_t* batch, size_t count) {
+		rfa::sessionLayer::OMMItemCmd itemCmd;
+		for (size_t i = 0; i < count; ++i) {
+			itemCmd.setMsg (*batch[i].msg);
+			itemCmd.setItemToken (items.token (batch[i].handle));
+			omm_provider.submit (&itemCmd, nullptr);
+		}
+	}
+
 	class provider_t :
 		public rfa::common::Client,
 		boost::noncopyable
 	{
 	public:
-		provider_t (const config_t& config, std::shared_ptr<rfa_t> rfa, std::shared_ptr<rfa::common::EventQueue> event_queue);
+/* Callbacks are timed against monitor when not null. */
+		provider_t (const config_t& config, std::shared_ptr<rfa_t> rfa, std::shared_ptr<rfa::common::EventQueue> event_queue, item_store_t& items, loop_monitor_t* monitor);
 		~provider_t();
 
 		bool init() throw (rfa::common::InvalidConfigurationException, rfa::common::InvalidUsageException);
 
-		bool createItemStream (const char* name, std::shared_ptr<item_stream_t> item_stream) throw (rfa::common::InvalidUsageException);
-		bool send (item_stream_t& item_stream, rfa::common::Msg& msg) throw (rfa::common::InvalidUsageException);
+/* Bulk creation for large symbol universes, store capacity is reserved once
+ * and per-item logging and timestamps are skipped.
+ */
+		bool createItemStreams (const std::vector<chromium::StringPiece>& names) throw (rfa::common::InvalidUsageException);
+/* Ensure the item holds a token of the current login, a new token requires
+ * the next message to be a refresh.  Returns false whilst muted.
+ */
+		bool acquireToken (item_store_t::handle_t handle);
+/* Submit a span of messages of one publish cycle in order with per-call
+ * rather than per-message overheads.  Returns false whilst muted, nothing
+ * is sent.
+ */
+		bool sendBatch (const outbound_msg_t* batch, size_t count) throw (rfa::common::InvalidUsageException);
+/* Any thread, true once a login success has been processed, a latch that
+ * later suspect or closed logins do not reset.
+ */
+		bool hasLoggedIn() const { return 0 != chromium::subtle::Acquire_Load (&token_epoch_); }
 
 /* RFA event callback. */
 		void processEvent (const rfa::common::Event& event);
@@ -106,7 +134,6 @@ namespace nezumi
 		void getServiceState (rfa::data::ElementList& elementList);
 		bool resetTokens();
 
-		uint32_t send (rfa::common::Msg& msg, rfa::sessionLayer::ItemToken& token, void* closure) throw (rfa::common::InvalidUsageException);
 		uint32_t submit (rfa::common::Msg& msg, rfa::sessionLayer::ItemToken& token, void* closure) throw (rfa::common::InvalidUsageException);
 
 		const config_t& config_;
@@ -138,12 +165,21 @@ namespace nezumi
  */
 		bool is_muted_;
 
+/* Incremented on each login success invalidating every item token, items
+ * regenerate on next publish.  Written by the event queue thread, read by
+ * publishers.
+ */
+		volatile chromium::subtle::Atomic32 token_epoch_;
+
 /* Last RespStatus details. */
 		int stream_state_;
 		int data_state_;
 
-/* Container of all item streams keyed by symbol name. */
-		std::unordered_map<std::string, std::weak_ptr<item_stream_t>> directory_;
+/* All item streams, owned by the application. */
+		item_store_t& items_;
+
+/* Health of the dispatching event loop. */
+		loop_monitor_t* monitor_;
 
 /** Performance Counters **/
 		boost::posix_time::ptime last_activity_;
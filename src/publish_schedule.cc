@@ -0,0 +1,45 @@
+/* Publish schedule of item handles.
+ */
+
+#include "publish_schedule.hh"
+
+void
+nezumi::publish_schedule_t::reserve (
+	size_t capacity
+	)
+{
+	wheel_.reserve (capacity);
+	intervals_.resize (capacity);
+}
+
+void
+nezumi::publish_schedule_t::schedule (
+	handle_t handle,
+	uint32_t interval,
+	uint64_t first_tick
+	)
+{
+	intervals_[handle] = 0 == interval ? 1 : interval;
+	wheel_.scheduleAt (handle, first_tick);
+}
+
+size_t
+nezumi::publish_schedule_t::advance (
+	uint64_t tick,
+	std::vector<handle_t>* expired
+	)
+{
+	const size_t first = expired->size();
+	const size_t due = wheel_.advance (tick, expired);
+	const uint64_t now = wheel_.now();
+	for (auto it = expired->begin() + first; it != expired->end(); ++it) {
+		const uint64_t interval = intervals_[*it];
+		uint64_t next = wheel_.expiry (*it) + interval;
+		if (next <= now)
+			next += ((now - next) / interval + 1) * interval;
+		wheel_.scheduleAt (*it, next);
+	}
+	return due;
+}
+
+/* eof */
@@ -0,0 +1,61 @@
+/* Publish schedule of item handles.
+ *
+ * Each handle publishes every interval ticks of the shard timer from a first
+ * tick, the timing wheel holds the next due tick of every handle.  Turning
+ * the schedule to a tick returns every handle due and re-arms it from the
+ * tick it was due rather than the tick turned to, such that schedules and
+ * the stagger phase survive a late or coalesced tick.  Periods missed
+ * entirely are skipped, not replayed.
+ *
+ * Free of RFA such that simulated runs may be verified without a provider.
+ */
+
+#ifndef __PUBLISH_SCHEDULE_HH__
+#define __PUBLISH_SCHEDULE_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "timing_wheel.hh"
+
+namespace nezumi
+{
+/* Timer ticks of resolution_us elapsed in elapsed_us, a time before the
+ * origin is tick zero.
+ */
+	inline uint64_t elapsed_ticks (int64_t elapsed_us, uint64_t resolution_us) {
+		return elapsed_us > 0 ? static_cast<uint64_t> (elapsed_us) / resolution_us : 0;
+	}
+
+	class publish_schedule_t :
+		boost::noncopyable
+	{
+	public:
+		typedef timing_wheel_t::handle_t handle_t;
+
+/* Handles are dense from zero and below capacity. */
+		void reserve (size_t capacity);
+
+/* First publish on first_tick then every interval ticks, zero is one. */
+		void schedule (handle_t handle, uint32_t interval, uint64_t first_tick);
+
+/* Appends every handle due up to tick to expired, returns the count. */
+		size_t advance (uint64_t tick, std::vector<handle_t>* expired);
+
+		uint32_t interval (handle_t handle) const { return intervals_[handle]; }
+
+	private:
+		timing_wheel_t wheel_;
+		std::vector<uint32_t> intervals_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __PUBLISH_SCHEDULE_HH__ */
+
+/* eof */
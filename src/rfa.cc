@@ -128,19 +128,7 @@ nezumi::rfa_t::init()
 	fix_rfa_string_path (&name);
 	staging->setBool (name, false);
 
-/* Session list */
-	const RFA_String sessionName (config_.session_name.c_str(), 0, false),
-			 connectionName (config_.connection_name.c_str(), 0, false);
-	name = "/Sessions/" + sessionName + "/connectionList";
-	fix_rfa_string_path (&name);
-	staging->setString (name, connectionName);
-/* Connection list */
-	name = "/Connections/" + connectionName + "/connectionType";
-	fix_rfa_string_path (&name);
-	staging->setString (name, kConnectionType);
 /* List of RSSL servers */
-	name = "/Connections/" + connectionName + "/serverList";
-	fix_rfa_string_path (&name);
 	std::ostringstream ss;
 	for (auto it = config_.rssl_servers.begin();
 		it != config_.rssl_servers.end();
@@ -150,13 +138,30 @@ nezumi::rfa_t::init()
 			ss << ", ";
 		ss << *it;
 	}		
-	value.set (ss.str().c_str());
-	staging->setString (name, value);
+	const RFA_String serverList (ss.str().c_str());
+
+/* One session and connection per publishing shard. */
+	for (size_t i = 0; i < config_.shard_count; ++i) {
+		const config_t shard_config (config_.shard (i));
+/* Session list */
+		const RFA_String sessionName (shard_config.session_name.c_str(), 0, false),
+				 connectionName (shard_config.connection_name.c_str(), 0, false);
+		name = "/Sessions/" + sessionName + "/connectionList";
+		fix_rfa_string_path (&name);
+		staging->setString (name, connectionName);
+/* Connection list */
+		name = "/Connections/" + connectionName + "/connectionType";
+		fix_rfa_string_path (&name);
+		staging->setString (name, kConnectionType);
+		name = "/Connections/" + connectionName + "/serverList";
+		fix_rfa_string_path (&name);
+		staging->setString (name, serverList);
 /* Default RSSL port */
-	name = "/Connections/" + connectionName + "/rsslPort";
-	fix_rfa_string_path (&name);
-	value.set (config_.rssl_default_port.c_str());
-	staging->setString (name, value);
+		name = "/Connections/" + connectionName + "/rsslPort";
+		fix_rfa_string_path (&name);
+		value.set (config_.rssl_default_port.c_str());
+		staging->setString (name, value);
+	}
 
 	rfa_config_.reset (rfa::config::ConfigDatabase::acquire (kContextName));
 	if (!(bool)rfa_config_)
@@ -0,0 +1,791 @@
+/* Reuters Wire Format container encoding and decoding.
+ */
+
+#include "rwf.hh"
+
+#include <cstring>
+
+#include "chromium/logging.hh"
+
+/* FieldList flags. */
+static const uint8_t kFieldListHasInfo		= 0x01;
+static const uint8_t kFieldListHasSetData	= 0x02;
+static const uint8_t kFieldListHasStandardData	= 0x08;
+
+/* ElementList flags. */
+static const uint8_t kElementListHasInfo	= 0x01;
+static const uint8_t kElementListHasSetData	= 0x02;
+static const uint8_t kElementListHasStandardData = 0x08;
+
+/* Map flags. */
+static const uint8_t kMapHasSetDefs		= 0x01;
+static const uint8_t kMapHasSummaryData		= 0x02;
+static const uint8_t kMapHasPerEntryPermData	= 0x04;
+static const uint8_t kMapHasTotalCountHint	= 0x08;
+static const uint8_t kMapHasKeyFieldId		= 0x10;
+
+/* MapEntry flags sharing the byte with the action. */
+static const uint8_t kMapEntryActionMask	= 0x0f;
+static const uint8_t kMapEntryHasPermData	= 0x10;
+
+/* Real hint byte. */
+static const uint8_t kRealHintMask		= 0x1f;
+static const uint8_t kRealBlank			= 0x20;
+
+/* Containers are written on the wire relative to the first container type. */
+static const uint8_t kContainerTypeMin		= nezumi::rwf::DT_NO_DATA;
+
+size_t
+nezumi::rwf::uint_length (
+	uint64_t value
+	)
+{
+	size_t length = 1;
+	while (length < 8 && (value >> (length * 8)) != 0)
+		++length;
+	return length;
+}
+
+size_t
+nezumi::rwf::int_length (
+	int64_t value
+	)
+{
+/* Smallest width where the value survives sign extension. */
+	size_t length = 1;
+	while (length < 8) {
+		const int64_t lo = -(static_cast<int64_t> (1) << (length * 8 - 1));
+		const int64_t hi =  (static_cast<int64_t> (1) << (length * 8 - 1)) - 1;
+		if (value >= lo && value <= hi)
+			break;
+		++length;
+	}
+	return length;
+}
+
+void
+nezumi::rwf::writer_t::putBytes (
+	const void* src,
+	size_t length
+	)
+{
+	if (!reserve (length))
+		return;
+	memcpy (pos_, src, length);
+	pos_ += length;
+}
+
+void
+nezumi::rwf::writer_t::putU15rb (
+	uint16_t value
+	)
+{
+	if (value < 0x80) {
+		putU8 (static_cast<uint8_t> (value));
+	} else if (value < 0x8000) {
+		putU8 (static_cast<uint8_t> (0x80 | (value >> 8)));
+		putU8 (static_cast<uint8_t> (value));
+	} else {
+		is_overflow_ = true;
+	}
+}
+
+void
+nezumi::rwf::writer_t::putU16ob (
+	uint16_t value
+	)
+{
+	if (value < 0xfe) {
+		putU8 (static_cast<uint8_t> (value));
+	} else {
+		putU8 (0xfe);
+		putU16 (value);
+	}
+}
+
+void
+nezumi::rwf::writer_t::putU30rb (
+	uint32_t value
+	)
+{
+	if (value < 0x40) {
+		putU8 (static_cast<uint8_t> (value));
+	} else if (value < 0x4000) {
+		putU8 (static_cast<uint8_t> (0x40 | (value >> 8)));
+		putU8 (static_cast<uint8_t> (value));
+	} else if (value < 0x400000) {
+		putU8 (static_cast<uint8_t> (0x80 | (value >> 16)));
+		putU16 (static_cast<uint16_t> (value));
+	} else if (value < 0x40000000) {
+		putU8 (static_cast<uint8_t> (0xc0 | (value >> 24)));
+		putU8 (static_cast<uint8_t> (value >> 16));
+		putU16 (static_cast<uint16_t> (value));
+	} else {
+		is_overflow_ = true;
+	}
+}
+
+void
+nezumi::rwf::writer_t::putUInt (
+	uint64_t value
+	)
+{
+	const size_t length = uint_length (value);
+	if (!reserve (length))
+		return;
+	for (size_t i = length; i > 0; --i)
+		*pos_++ = static_cast<uint8_t> (value >> ((i - 1) * 8));
+}
+
+void
+nezumi::rwf::writer_t::putInt (
+	int64_t value
+	)
+{
+	const size_t length = int_length (value);
+	if (!reserve (length))
+		return;
+	const uint64_t bits = static_cast<uint64_t> (value);
+	for (size_t i = length; i > 0; --i)
+		*pos_++ = static_cast<uint8_t> (bits >> ((i - 1) * 8));
+}
+
+void
+nezumi::rwf::length_prefix_t::begin (
+	writer_t& writer
+	)
+{
+	prefix_ = writer.pos();
+	writer.skip (3);
+}
+
+void
+nezumi::rwf::length_prefix_t::end (
+	writer_t& writer
+	)
+{
+	if (writer.isOverflow())
+		return;
+	uint8_t* payload = prefix_ + 3;
+	const size_t length = static_cast<size_t> (writer.pos() - payload);
+	if (length < 0xfe) {
+		prefix_[0] = static_cast<uint8_t> (length);
+		memmove (prefix_ + 1, payload, length);
+		writer.rewind (prefix_ + 1 + length);
+	} else if (length <= 0xffff) {
+		prefix_[0] = 0xfe;
+		prefix_[1] = static_cast<uint8_t> (length >> 8);
+		prefix_[2] = static_cast<uint8_t> (length);
+	} else {
+/* Entry too large for a u16ob length. */
+		writer.rewind (prefix_);
+		writer.reserve (~static_cast<size_t> (0));
+	}
+}
+
+/* FieldList */
+
+void
+nezumi::rwf::field_list_encoder_t::init (
+	uint16_t dictionary_id,
+	int16_t field_list_num
+	)
+{
+	writer_.putU8 (kFieldListHasInfo | kFieldListHasStandardData);
+/* Info length, dictionary id as u15rb, field list number. */
+	uint8_t* info_length = writer_.pos();
+	writer_.putU8 (0);
+	writer_.putU15rb (dictionary_id);
+	writer_.putU16 (static_cast<uint16_t> (field_list_num));
+	if (!writer_.isOverflow())
+		*info_length = static_cast<uint8_t> (writer_.pos() - info_length - 1);
+	count_offset_ = writer_.pos();
+	writer_.putU16 (0);
+	count_ = 0;
+}
+
+void
+nezumi::rwf::field_list_encoder_t::putHeader (
+	int16_t fid
+	)
+{
+	DCHECK(nullptr != count_offset_);
+	writer_.putU16 (static_cast<uint16_t> (fid));
+	++count_;
+}
+
+void
+nezumi::rwf::field_list_encoder_t::addUInt (
+	int16_t fid,
+	uint64_t value
+	)
+{
+	putHeader (fid);
+	writer_.putU16ob (static_cast<uint16_t> (uint_length (value)));
+	writer_.putUInt (value);
+}
+
+void
+nezumi::rwf::field_list_encoder_t::addReal (
+	int16_t fid,
+	int64_t mantissa,
+	uint8_t hint
+	)
+{
+	putHeader (fid);
+	writer_.putU16ob (static_cast<uint16_t> (1 + int_length (mantissa)));
+	writer_.putU8 (hint & kRealHintMask);
+	writer_.putInt (mantissa);
+}
+
+void
+nezumi::rwf::field_list_encoder_t::addAscii (
+	int16_t fid,
+	const char* value,
+	size_t length
+	)
+{
+	putHeader (fid);
+	if (length > 0xffff) {
+		writer_.reserve (~static_cast<size_t> (0));
+		return;
+	}
+	writer_.putU16ob (static_cast<uint16_t> (length));
+	writer_.putBytes (value, length);
+}
+
+void
+nezumi::rwf::field_list_encoder_t::addBlank (
+	int16_t fid
+	)
+{
+	putHeader (fid);
+	writer_.putU8 (0);
+}
+
+size_t
+nezumi::rwf::field_list_encoder_t::addFixed (
+	int16_t fid,
+	uint8_t width
+	)
+{
+	DCHECK_LT(width, 0xfe);
+	putHeader (fid);
+	writer_.putU8 (width);
+	const size_t offset = writer_.size();
+	if (writer_.reserve (width)) {
+		memset (writer_.pos(), 0, width);
+		writer_.skip (width);
+	}
+	return offset;
+}
+
+size_t
+nezumi::rwf::field_list_encoder_t::complete()
+{
+	if (writer_.isOverflow())
+		return 0;
+	count_offset_[0] = static_cast<uint8_t> (count_ >> 8);
+	count_offset_[1] = static_cast<uint8_t> (count_);
+	return writer_.size();
+}
+
+/* ElementList */
+
+void
+nezumi::rwf::element_list_encoder_t::init()
+{
+	writer_.putU8 (kElementListHasStandardData);
+	count_offset_ = writer_.pos();
+	writer_.putU16 (0);
+	count_ = 0;
+}
+
+void
+nezumi::rwf::element_list_encoder_t::putHeader (
+	const char* name,
+	uint8_t data_type
+	)
+{
+	DCHECK(nullptr != count_offset_);
+	const size_t name_length = strlen (name);
+	if (name_length >= 0x8000) {
+		writer_.reserve (~static_cast<size_t> (0));
+		return;
+	}
+	writer_.putU15rb (static_cast<uint16_t> (name_length));
+	writer_.putBytes (name, name_length);
+	writer_.putU8 (data_type);
+	++count_;
+}
+
+void
+nezumi::rwf::element_list_encoder_t::addUInt (
+	const char* name,
+	uint64_t value
+	)
+{
+	putHeader (name, DT_UINT);
+	writer_.putU16ob (static_cast<uint16_t> (uint_length (value)));
+	writer_.putUInt (value);
+}
+
+void
+nezumi::rwf::element_list_encoder_t::addReal (
+	const char* name,
+	int64_t mantissa,
+	uint8_t hint
+	)
+{
+	putHeader (name, DT_REAL);
+	writer_.putU16ob (static_cast<uint16_t> (1 + int_length (mantissa)));
+	writer_.putU8 (hint & kRealHintMask);
+	writer_.putInt (mantissa);
+}
+
+void
+nezumi::rwf::element_list_encoder_t::addAscii (
+	const char* name,
+	const char* value,
+	size_t length
+	)
+{
+	putHeader (name, DT_ASCII_STRING);
+	if (length > 0xffff) {
+		writer_.reserve (~static_cast<size_t> (0));
+		return;
+	}
+	writer_.putU16ob (static_cast<uint16_t> (length));
+	writer_.putBytes (value, length);
+}
+
+size_t
+nezumi::rwf::element_list_encoder_t::complete()
+{
+	if (writer_.isOverflow())
+		return 0;
+	count_offset_[0] = static_cast<uint8_t> (count_ >> 8);
+	count_offset_[1] = static_cast<uint8_t> (count_);
+	return writer_.size();
+}
+
+/* Map */
+
+void
+nezumi::rwf::map_encoder_t::init (
+	uint8_t container_type,
+	uint32_t total_count_hint
+	)
+{
+	DCHECK_GE(container_type, kContainerTypeMin);
+	writer_.putU8 (total_count_hint > 0 ? kMapHasTotalCountHint : 0);
+	writer_.putU8 (DT_ASCII_STRING);
+	writer_.putU8 (static_cast<uint8_t> (container_type - kContainerTypeMin));
+	if (total_count_hint > 0)
+		writer_.putU30rb (total_count_hint);
+	count_offset_ = writer_.pos();
+	writer_.putU16 (0);
+	count_ = 0;
+}
+
+void
+nezumi::rwf::map_encoder_t::beginEntry (
+	uint8_t action,
+	const char* key,
+	size_t key_length
+	)
+{
+	DCHECK(nullptr != count_offset_);
+	DCHECK(!is_entry_open_);
+	is_entry_open_ = true;
+	if (key_length >= 0x8000) {
+		writer_.reserve (~static_cast<size_t> (0));
+		return;
+	}
+	writer_.putU8 (action & kMapEntryActionMask);
+	writer_.putU15rb (static_cast<uint16_t> (key_length));
+	writer_.putBytes (key, key_length);
+	prefix_.begin (writer_);
+	++count_;
+}
+
+void
+nezumi::rwf::map_encoder_t::endEntry (
+	size_t payload_length
+	)
+{
+	DCHECK(is_entry_open_);
+	is_entry_open_ = false;
+	writer_.skip (payload_length);
+	prefix_.end (writer_);
+}
+
+void
+nezumi::rwf::map_encoder_t::addEntry (
+	uint8_t action,
+	const char* key,
+	size_t key_length,
+	const uint8_t* payload,
+	size_t payload_length
+	)
+{
+	beginEntry (action, key, key_length);
+	if (writer_.reserve (payload_length))
+		memcpy (writer_.pos(), payload, payload_length);
+	endEntry (payload_length);
+}
+
+/* Deleted entries carry no payload. */
+void
+nezumi::rwf::map_encoder_t::addDelete (
+	const char* key,
+	size_t key_length
+	)
+{
+	DCHECK(nullptr != count_offset_);
+	if (key_length >= 0x8000) {
+		writer_.reserve (~static_cast<size_t> (0));
+		return;
+	}
+	writer_.putU8 (MAP_DELETE);
+	writer_.putU15rb (static_cast<uint16_t> (key_length));
+	writer_.putBytes (key, key_length);
+	++count_;
+}
+
+size_t
+nezumi::rwf::map_encoder_t::complete()
+{
+	DCHECK(!is_entry_open_);
+	if (writer_.isOverflow())
+		return 0;
+	count_offset_[0] = static_cast<uint8_t> (count_ >> 8);
+	count_offset_[1] = static_cast<uint8_t> (count_);
+	return writer_.size();
+}
+
+/* Decoding */
+
+bool
+nezumi::rwf::reader_t::getU8 (
+	uint8_t* value
+	)
+{
+	if (remaining() < 1)
+		return false;
+	*value = *pos_++;
+	return true;
+}
+
+bool
+nezumi::rwf::reader_t::getU16 (
+	uint16_t* value
+	)
+{
+	if (remaining() < 2)
+		return false;
+	*value = static_cast<uint16_t> ((pos_[0] << 8) | pos_[1]);
+	pos_ += 2;
+	return true;
+}
+
+bool
+nezumi::rwf::reader_t::getU15rb (
+	uint16_t* value
+	)
+{
+	uint8_t b0, b1;
+	if (!getU8 (&b0))
+		return false;
+	if (0 == (b0 & 0x80)) {
+		*value = b0;
+		return true;
+	}
+	if (!getU8 (&b1))
+		return false;
+	*value = static_cast<uint16_t> (((b0 & 0x7f) << 8) | b1);
+	return true;
+}
+
+bool
+nezumi::rwf::reader_t::getU16ob (
+	uint16_t* value
+	)
+{
+	uint8_t b0;
+	if (!getU8 (&b0))
+		return false;
+	if (b0 < 0xfe) {
+		*value = b0;
+		return true;
+	}
+/* 0xff is reserved. */
+	if (0xfe != b0)
+		return false;
+	return getU16 (value);
+}
+
+bool
+nezumi::rwf::reader_t::getU30rb (
+	uint32_t* value
+	)
+{
+	uint8_t b0;
+	if (!getU8 (&b0))
+		return false;
+	const size_t extra = b0 >> 6;
+	uint32_t v = b0 & 0x3f;
+	for (size_t i = 0; i < extra; ++i) {
+		uint8_t b;
+		if (!getU8 (&b))
+			return false;
+		v = (v << 8) | b;
+	}
+	*value = v;
+	return true;
+}
+
+bool
+nezumi::rwf::reader_t::getBytes (
+	size_t length,
+	const uint8_t** value
+	)
+{
+	if (remaining() < length)
+		return false;
+	*value = pos_;
+	pos_ += length;
+	return true;
+}
+
+/* Blank values, zero length, are reported as failure.
+ */
+bool
+nezumi::rwf::decode_uint (
+	const uint8_t* data,
+	size_t length,
+	uint64_t* value
+	)
+{
+	if (0 == length || length > 8)
+		return false;
+	uint64_t v = 0;
+	for (size_t i = 0; i < length; ++i)
+		v = (v << 8) | data[i];
+	*value = v;
+	return true;
+}
+
+bool
+nezumi::rwf::decode_int (
+	const uint8_t* data,
+	size_t length,
+	int64_t* value
+	)
+{
+	if (0 == length || length > 8)
+		return false;
+/* Sign extend from the leading byte. */
+	uint64_t v = (data[0] & 0x80) ? ~static_cast<uint64_t> (0) : 0;
+	for (size_t i = 0; i < length; ++i)
+		v = (v << 8) | data[i];
+	*value = static_cast<int64_t> (v);
+	return true;
+}
+
+bool
+nezumi::rwf::decode_real (
+	const uint8_t* data,
+	size_t length,
+	int64_t* mantissa,
+	uint8_t* hint
+	)
+{
+	if (0 == length || (data[0] & kRealBlank))
+		return false;
+	*hint = data[0] & kRealHintMask;
+	return decode_int (data + 1, length - 1, mantissa);
+}
+
+nezumi::rwf::field_list_decoder_t::field_list_decoder_t (
+	const uint8_t* buffer,
+	size_t length
+	) :
+	reader_ (buffer, length),
+	dictionary_id_ (0),
+	field_list_num_ (0),
+	count_ (0),
+	index_ (0)
+{
+}
+
+bool
+nezumi::rwf::field_list_decoder_t::init()
+{
+	uint8_t flags;
+	if (!reader_.getU8 (&flags))
+		return false;
+	if (flags & kFieldListHasInfo) {
+		uint8_t info_length;
+		const uint8_t* info;
+		if (!reader_.getU8 (&info_length) || !reader_.getBytes (info_length, &info))
+			return false;
+		reader_t info_reader (info, info_length);
+		uint16_t field_list_num;
+		if (!info_reader.getU15rb (&dictionary_id_) || !info_reader.getU16 (&field_list_num))
+			return false;
+		field_list_num_ = static_cast<int16_t> (field_list_num);
+	}
+/* Set-defined data requires the set definition database, not supported. */
+	if (flags & kFieldListHasSetData)
+		return false;
+	if (flags & kFieldListHasStandardData)
+		return reader_.getU16 (&count_);
+	count_ = 0;
+	return true;
+}
+
+bool
+nezumi::rwf::field_list_decoder_t::next (
+	field_entry_t* entry
+	)
+{
+	if (index_ >= count_)
+		return false;
+	uint16_t fid, length;
+	if (!reader_.getU16 (&fid) ||
+	    !reader_.getU16ob (&length) ||
+	    !reader_.getBytes (length, &entry->data))
+		return false;
+	entry->fid = static_cast<int16_t> (fid);
+	entry->length = length;
+	++index_;
+	return true;
+}
+
+nezumi::rwf::element_list_decoder_t::element_list_decoder_t (
+	const uint8_t* buffer,
+	size_t length
+	) :
+	reader_ (buffer, length),
+	count_ (0),
+	index_ (0)
+{
+}
+
+bool
+nezumi::rwf::element_list_decoder_t::init()
+{
+	uint8_t flags;
+	if (!reader_.getU8 (&flags))
+		return false;
+	if (flags & kElementListHasInfo) {
+		uint8_t info_length;
+		const uint8_t* info;
+		if (!reader_.getU8 (&info_length) || !reader_.getBytes (info_length, &info))
+			return false;
+	}
+	if (flags & kElementListHasSetData)
+		return false;
+	if (flags & kElementListHasStandardData)
+		return reader_.getU16 (&count_);
+	count_ = 0;
+	return true;
+}
+
+bool
+nezumi::rwf::element_list_decoder_t::next (
+	element_entry_t* entry
+	)
+{
+	if (index_ >= count_)
+		return false;
+	uint16_t name_length, length;
+	const uint8_t* name;
+	if (!reader_.getU15rb (&name_length) ||
+	    !reader_.getBytes (name_length, &name) ||
+	    !reader_.getU8 (&entry->data_type))
+		return false;
+	entry->name = reinterpret_cast<const char*> (name);
+	entry->name_length = name_length;
+	if (DT_NO_DATA == entry->data_type) {
+		entry->data = nullptr;
+		entry->length = 0;
+	} else {
+		if (!reader_.getU16ob (&length) || !reader_.getBytes (length, &entry->data))
+			return false;
+		entry->length = length;
+	}
+	++index_;
+	return true;
+}
+
+nezumi::rwf::map_decoder_t::map_decoder_t (
+	const uint8_t* buffer,
+	size_t length
+	) :
+	reader_ (buffer, length),
+	key_type_ (0),
+	container_type_ (0),
+	total_count_hint_ (0),
+	count_ (0),
+	index_ (0)
+{
+}
+
+bool
+nezumi::rwf::map_decoder_t::init()
+{
+	uint8_t flags, container_type;
+	if (!reader_.getU8 (&flags) ||
+	    !reader_.getU8 (&key_type_) ||
+	    !reader_.getU8 (&container_type))
+		return false;
+	container_type_ = container_type + kContainerTypeMin;
+/* Only the subset produced by map_encoder_t is understood. */
+	if (flags & (kMapHasSetDefs | kMapHasSummaryData | kMapHasPerEntryPermData))
+		return false;
+	if (flags & kMapHasKeyFieldId) {
+		uint16_t key_field_id;
+		if (!reader_.getU16 (&key_field_id))
+			return false;
+	}
+	if (flags & kMapHasTotalCountHint) {
+		if (!reader_.getU30rb (&total_count_hint_))
+			return false;
+	}
+	return reader_.getU16 (&count_);
+}
+
+bool
+nezumi::rwf::map_decoder_t::next (
+	map_entry_t* entry
+	)
+{
+	if (index_ >= count_)
+		return false;
+	uint8_t flags;
+	uint16_t key_length, length;
+	const uint8_t* key;
+	if (!reader_.getU8 (&flags))
+		return false;
+	if (flags & kMapEntryHasPermData)
+		return false;
+	entry->action = flags & kMapEntryActionMask;
+	if (!reader_.getU15rb (&key_length) || !reader_.getBytes (key_length, &key))
+		return false;
+	entry->key = reinterpret_cast<const char*> (key);
+	entry->key_length = key_length;
+	if (MAP_DELETE == entry->action || DT_NO_DATA == container_type_) {
+		entry->data = nullptr;
+		entry->length = 0;
+	} else {
+		if (!reader_.getU16ob (&length) || !reader_.getBytes (length, &entry->data))
+			return false;
+		entry->length = length;
+	}
+	++index_;
+	return true;
+}
+
+/* eof */
@@ -0,0 +1,348 @@
+/* Reuters Wire Format container encoding and decoding.
+ *
+ * Self-contained encoders for FieldList, ElementList and Map containers that
+ * write directly into caller supplied storage, with matching decoders for
+ * verification.  Primitive coverage is limited to what the provider
+ * publishes: UInt, Real with hint, and ASCII string.
+ *
+ * Encoders never allocate nor throw, overflowing the buffer latches an error
+ * state and complete() returns zero.
+ */
+
+#ifndef __RWF_HH__
+#define __RWF_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nezumi
+{
+namespace rwf
+{
+/* Data types, primitives below 128 and containers from 128. */
+	enum {
+		DT_INT			= 3,
+		DT_UINT			= 4,
+		DT_REAL			= 8,
+		DT_ASCII_STRING		= 17,
+		DT_NO_DATA		= 128,
+		DT_FIELD_LIST		= 132,
+		DT_ELEMENT_LIST		= 133,
+		DT_FILTER_LIST		= 135,
+		DT_MAP			= 137
+	};
+
+/* Real hints, EXPONENT0 represents an integer. */
+	enum {
+		EXPONENT_14		= 0,
+		EXPONENT_6		= 8,
+		EXPONENT_4		= 10,
+		EXPONENT_2		= 12,
+		EXPONENT0		= 14,
+		EXPONENT2		= 16,
+		EXPONENT7		= 21,
+		DIVISOR_1		= 22,
+		DIVISOR_256		= 30
+	};
+
+/* Map entry actions. */
+	enum {
+		MAP_UPDATE		= 1,
+		MAP_ADD			= 2,
+		MAP_DELETE		= 3
+	};
+
+/* Bounded big-endian output cursor. */
+	class writer_t
+	{
+	public:
+		writer_t (uint8_t* buffer, size_t length) :
+			begin_ (buffer),
+			pos_ (buffer),
+			end_ (buffer + length),
+			is_overflow_ (false)
+		{
+		}
+
+		bool reserve (size_t length) {
+			if (is_overflow_ || static_cast<size_t> (end_ - pos_) < length) {
+				is_overflow_ = true;
+				return false;
+			}
+			return true;
+		}
+
+		void putU8 (uint8_t value) {
+			if (reserve (1)) *pos_++ = value;
+		}
+		void putU16 (uint16_t value) {
+			if (!reserve (2)) return;
+			pos_[0] = static_cast<uint8_t> (value >> 8);
+			pos_[1] = static_cast<uint8_t> (value);
+			pos_ += 2;
+		}
+		void putBytes (const void* src, size_t length);
+/* Variable length encodings: 15-bit with reserved bit, 16-bit with optional
+ * byte, and 30-bit with two reserved bits.
+ */
+		void putU15rb (uint16_t value);
+		void putU16ob (uint16_t value);
+		void putU30rb (uint32_t value);
+
+/* Length-specified integers, minimal width. */
+		void putUInt (uint64_t value);
+		void putInt (int64_t value);
+
+		uint8_t* data() const { return begin_; }
+		uint8_t* pos() const { return pos_; }
+		size_t size() const { return static_cast<size_t> (pos_ - begin_); }
+		size_t remaining() const { return static_cast<size_t> (end_ - pos_); }
+		bool isOverflow() const { return is_overflow_; }
+
+		void skip (size_t length) {
+			if (reserve (length)) pos_ += length;
+		}
+		void rewind (uint8_t* pos) { pos_ = pos; }
+
+	private:
+		uint8_t* begin_;
+		uint8_t* pos_;
+		uint8_t* end_;
+		bool is_overflow_;
+	};
+
+/* Primitive sizes as written by writer_t. */
+	size_t uint_length (uint64_t value);
+	size_t int_length (int64_t value);
+
+/* Entry payload with a u16ob length prefix whose final size is unknown until
+ * the payload is written.  Three bytes are reserved and the payload shifted
+ * down when the short form suffices.
+ */
+	class length_prefix_t
+	{
+	public:
+		void begin (writer_t& writer);
+		void end (writer_t& writer);
+	private:
+		uint8_t* prefix_;
+	};
+
+	class field_list_encoder_t
+	{
+	public:
+		field_list_encoder_t (uint8_t* buffer, size_t length) :
+			writer_ (buffer, length),
+			count_offset_ (nullptr),
+			count_ (0)
+		{
+		}
+
+/* Start the list, with field list info as used by all RDM payloads. */
+		void init (uint16_t dictionary_id, int16_t field_list_num);
+
+		void addUInt (int16_t fid, uint64_t value);
+		void addReal (int16_t fid, int64_t mantissa, uint8_t hint);
+		void addAscii (int16_t fid, const char* value, size_t length);
+		void addBlank (int16_t fid);
+
+/* Reserve a fixed width value for later in-place patching, returns the byte
+ * offset of the value from the start of the buffer.
+ */
+		size_t addFixed (int16_t fid, uint8_t width);
+
+/* Returns encoded length, zero on overflow. */
+		size_t complete();
+
+		writer_t& writer() { return writer_; }
+
+	private:
+		void putHeader (int16_t fid);
+
+		writer_t writer_;
+		uint8_t* count_offset_;
+		uint16_t count_;
+	};
+
+	class element_list_encoder_t
+	{
+	public:
+		element_list_encoder_t (uint8_t* buffer, size_t length) :
+			writer_ (buffer, length),
+			count_offset_ (nullptr),
+			count_ (0)
+		{
+		}
+
+		void init();
+
+		void addUInt (const char* name, uint64_t value);
+		void addReal (const char* name, int64_t mantissa, uint8_t hint);
+		void addAscii (const char* name, const char* value, size_t length);
+
+		size_t complete();
+
+	private:
+		void putHeader (const char* name, uint8_t data_type);
+
+		writer_t writer_;
+		uint8_t* count_offset_;
+		uint16_t count_;
+	};
+
+	class map_encoder_t
+	{
+	public:
+		map_encoder_t (uint8_t* buffer, size_t length) :
+			writer_ (buffer, length),
+			count_offset_ (nullptr),
+			count_ (0),
+			is_entry_open_ (false)
+		{
+		}
+
+/* Keys are limited to ASCII strings, a total count hint of zero is omitted. */
+		void init (uint8_t container_type, uint32_t total_count_hint);
+
+/* Nested payload: begin an entry, encode the container directly into
+ * writer().pos() up to remaining(), then end the entry with the payload
+ * length.
+ */
+		void beginEntry (uint8_t action, const char* key, size_t key_length);
+		uint8_t* pos() const { return writer_.pos(); }
+		size_t remaining() const { return writer_.remaining(); }
+		void endEntry (size_t payload_length);
+
+/* Pre-encoded payload. */
+		void addEntry (uint8_t action, const char* key, size_t key_length, const uint8_t* payload, size_t payload_length);
+		void addDelete (const char* key, size_t key_length);
+
+		size_t complete();
+
+	private:
+		writer_t writer_;
+		uint8_t* count_offset_;
+		uint16_t count_;
+		length_prefix_t prefix_;
+		bool is_entry_open_;
+	};
+
+/* Decoding */
+
+/* Bounded big-endian input cursor. */
+	class reader_t
+	{
+	public:
+		reader_t (const uint8_t* buffer, size_t length) :
+			pos_ (buffer),
+			end_ (buffer + length)
+		{
+		}
+
+		bool getU8 (uint8_t* value);
+		bool getU16 (uint16_t* value);
+		bool getU15rb (uint16_t* value);
+		bool getU16ob (uint16_t* value);
+		bool getU30rb (uint32_t* value);
+		bool getBytes (size_t length, const uint8_t** value);
+
+		size_t remaining() const { return static_cast<size_t> (end_ - pos_); }
+
+	private:
+		const uint8_t* pos_;
+		const uint8_t* end_;
+	};
+
+	bool decode_uint (const uint8_t* data, size_t length, uint64_t* value);
+	bool decode_int (const uint8_t* data, size_t length, int64_t* value);
+	bool decode_real (const uint8_t* data, size_t length, int64_t* mantissa, uint8_t* hint);
+
+	struct field_entry_t {
+		int16_t fid;
+		const uint8_t* data;
+		size_t length;
+	};
+
+	class field_list_decoder_t
+	{
+	public:
+		field_list_decoder_t (const uint8_t* buffer, size_t length);
+
+/* Parse the container header, returns false on malformed input. */
+		bool init();
+/* Returns false at end of list or on malformed input. */
+		bool next (field_entry_t* entry);
+
+		uint16_t dictionaryId() const { return dictionary_id_; }
+		int16_t fieldListNum() const { return field_list_num_; }
+		uint16_t count() const { return count_; }
+
+	private:
+		reader_t reader_;
+		uint16_t dictionary_id_;
+		int16_t field_list_num_;
+		uint16_t count_;
+		uint16_t index_;
+	};
+
+	struct element_entry_t {
+		const char* name;
+		size_t name_length;
+		uint8_t data_type;
+		const uint8_t* data;
+		size_t length;
+	};
+
+	class element_list_decoder_t
+	{
+	public:
+		element_list_decoder_t (const uint8_t* buffer, size_t length);
+
+		bool init();
+		bool next (element_entry_t* entry);
+
+		uint16_t count() const { return count_; }
+
+	private:
+		reader_t reader_;
+		uint16_t count_;
+		uint16_t index_;
+	};
+
+	struct map_entry_t {
+		uint8_t action;
+		const char* key;
+		size_t key_length;
+		const uint8_t* data;
+		size_t length;
+	};
+
+	class map_decoder_t
+	{
+	public:
+		map_decoder_t (const uint8_t* buffer, size_t length);
+
+		bool init();
+		bool next (map_entry_t* entry);
+
+		uint8_t keyType() const { return key_type_; }
+		uint8_t containerType() const { return container_type_; }
+		uint32_t totalCountHint() const { return total_count_hint_; }
+		uint16_t count() const { return count_; }
+
+	private:
+		reader_t reader_;
+		uint8_t key_type_;
+		uint8_t container_type_;
+		uint32_t total_count_hint_;
+		uint16_t count_;
+		uint16_t index_;
+	};
+
+} /* namespace rwf */
+} /* namespace nezumi */
+
+#endif /* __RWF_HH__ */
+
+/* eof */
@@ -0,0 +1,170 @@
+/* Compile-time field schema for published records.
+ *
+ * A record type declares its dictionary, field list number and an ordered
+ * boost::mpl sequence of fields, each field binding a FID to a wire type:
+ *
+ *   struct market_price_t {
+ *     typedef schema::field<2, schema::uint_type> RDNDISPLAY;
+ *     typedef schema::field<6, schema::real_type<rwf::EXPONENT0> > TRDPRC_1;
+ *     typedef boost::mpl::vector<RDNDISPLAY, TRDPRC_1> fields;
+ *     enum { dictionary_id = 1, field_list_id = 3 };
+ *   };
+ *
+ * index_of<market_price_t, market_price_t::TRDPRC_1> fails to compile for a
+ * field not within the record, and the encoder resolves the wire type of
+ * every field at compile time such that encoding a record is a template copy
+ * followed by one unrolled store per changed field.
+ */
+
+#ifndef __SCHEMA_HH__
+#define __SCHEMA_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* Boost type sequences. */
+#include <boost/mpl/end.hpp>
+#include <boost/mpl/find.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/type_traits/is_same.hpp>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "chromium/logging.hh"
+#include "field_template.hh"
+
+namespace nezumi
+{
+namespace schema
+{
+/* Wire types, all values are held as 64-bit words. */
+	struct uint_type
+	{
+		typedef uint64_t value_type;
+
+		static unsigned define (field_template_t& field_template, int16_t fid) {
+			return field_template.addUInt (fid);
+		}
+		static void patch (const field_template_t& field_template, uint8_t* dst, unsigned slot, uint64_t bits) {
+			field_template.setUInt (dst, slot, bits);
+		}
+		static uint64_t to_bits (value_type value) { return value; }
+		static value_type from_bits (uint64_t bits) { return bits; }
+	};
+
+	template <uint8_t Hint>
+	struct real_type
+	{
+		typedef int64_t value_type;
+
+		static unsigned define (field_template_t& field_template, int16_t fid) {
+			return field_template.addReal (fid, Hint);
+		}
+		static void patch (const field_template_t& field_template, uint8_t* dst, unsigned slot, uint64_t bits) {
+			field_template.setReal (dst, slot, static_cast<int64_t> (bits));
+		}
+		static uint64_t to_bits (value_type value) { return static_cast<uint64_t> (value); }
+		static value_type from_bits (uint64_t bits) { return static_cast<int64_t> (bits); }
+	};
+
+	template <int16_t Fid, class Type>
+	struct field
+	{
+		typedef Type type;
+		typedef typename Type::value_type value_type;
+		static const int16_t fid = Fid;
+	};
+
+/* Position of a field within a record, compile error if absent. */
+	template <class Record, class Field>
+	struct index_of
+	{
+		typedef typename boost::mpl::find<typename Record::fields, Field>::type iterator;
+		typedef typename boost::mpl::end<typename Record::fields>::type last;
+		static_assert (!boost::is_same<iterator, last>::value, "field is not a member of the record schema");
+		static const unsigned value = iterator::pos::value;
+	};
+
+/* Encodes any subset of a record's fields from pre-encoded templates, one
+ * template per field mask built on first use.  Field masks carry one bit per
+ * field in schema order.
+ */
+	template <class Record>
+	class record_encoder_t :
+		boost::noncopyable
+	{
+	public:
+		enum {
+			size		= boost::mpl::size<typename Record::fields>::value,
+			all_fields	= (1u << size) - 1
+		};
+		static_assert (size > 0 && size <= 8, "record schema must define between 1 and 8 fields");
+
+		const field_template_t& getTemplate (unsigned fields) {
+			DCHECK_LE(fields, static_cast<unsigned> (all_fields));
+			std::unique_ptr<field_template_t>& field_template = templates_[fields];
+			if (!(bool)field_template) {
+				field_template.reset (new field_template_t (Record::dictionary_id, Record::field_list_id));
+				define_fn fn = { field_template.get(), fields };
+				boost::mpl::for_each<typename Record::fields> (fn);
+				field_template->complete();
+			}
+			return *field_template.get();
+		}
+
+/* Source provides uint64_t bits (unsigned field) for raw field values.
+ * Returns encoded length, zero if capacity is insufficient.
+ */
+		template <class Source>
+		size_t encode (const Source& record, unsigned fields, uint8_t* dst, size_t capacity) {
+			const field_template_t& field_template = getTemplate (fields);
+			if (field_template.size() > capacity)
+				return 0;
+			field_template.write (dst);
+			unsigned slot = 0;
+			patch_fn<Source> fn = { &field_template, &record, fields, dst, &slot };
+			boost::mpl::for_each<typename Record::fields> (fn);
+			return field_template.size();
+		}
+
+	private:
+		struct define_fn {
+			field_template_t* field_template;
+			unsigned fields;
+
+			template <class Field>
+			void operator() (Field) const {
+				if (fields & (1u << index_of<Record, Field>::value))
+					Field::type::define (*field_template, Field::fid);
+			}
+		};
+
+		template <class Source>
+		struct patch_fn {
+			const field_template_t* field_template;
+			const Source* record;
+			unsigned fields;
+			uint8_t* dst;
+			unsigned* slot;
+
+			template <class Field>
+			void operator() (Field) const {
+				const unsigned i = index_of<Record, Field>::value;
+				if (fields & (1u << i))
+					Field::type::patch (*field_template, dst, (*slot)++, record->bits (i));
+			}
+		};
+
+		std::unique_ptr<field_template_t> templates_[all_fields + 1];
+	};
+
+} /* namespace schema */
+} /* namespace nezumi */
+
+#endif /* __SCHEMA_HH__ */
+
+/* eof */
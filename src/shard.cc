@@ -0,0 +1,645 @@
+/* Publishing shard.
+ */
+
+#include "shard.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include <emmintrin.h>
+#include <windows.h>
+
+#include "chromium/binary_log.hh"
+#include "chromium/logging.hh"
+#include "error.hh"
+#include "provider.hh"
+#include "rfa.hh"
+#include "rfaostream.hh"
+
+using rfa::common::RFA_String;
+
+/* Backstop on an idle doorbell wait, RFA events and posted commands ring. */
+static const unsigned long kIdleWaitMs = 100;
+
+namespace nezumi
+{
+/* Timer event marshalled from the timer thread. */
+	class tick_command_t : public command_t
+	{
+	public:
+		tick_command_t (shard_t* shard, const boost::chrono::time_point<boost::chrono::system_clock>& t) :
+			shard_ (shard),
+			t_ (t)
+		{
+		}
+		void execute() override {
+			shard_->processTick (t_);
+		}
+	private:
+		shard_t* shard_;
+		const boost::chrono::time_point<boost::chrono::system_clock> t_;
+	};
+} /* namespace nezumi */
+
+nezumi::shard_t::shard_t (
+	size_t id,
+	const config_t& config,
+	std::shared_ptr<rfa_t> rfa
+	) :
+	id_ (id),
+	config_ (config.shard (id)),
+	rfa_ (rfa),
+	monitor_ ("Shard " + std::to_string (static_cast<unsigned long long> (id))),
+	ticks_in_flight_ (0)
+{
+	memset (submit_stats_, 0, sizeof (submit_stats_));
+}
+
+nezumi::shard_t::~shard_t()
+{
+	stop();
+	envelopes_.reset();
+/* Release everything with an RFA dependency. */
+	assert (provider_.use_count() <= 1);
+	provider_.reset();
+	assert (event_queue_.use_count() <= 1);
+	event_queue_.reset();
+}
+
+bool
+nezumi::shard_t::init()
+{
+	VLOG(2) << "Initializing shard " << id_ << ".";
+
+/* RFA asynchronous event queue. */
+	const RFA_String eventQueueName (config_.event_queue_name.c_str(), 0, false);
+	event_queue_.reset (rfa::common::EventQueue::create (eventQueueName), std::mem_fun (&rfa::common::EventQueue::destroy));
+	if (!(bool)event_queue_)
+		return false;
+
+/* Service name shared by all item streams. */
+	service_name_.set (config_.service_name.c_str(), 0, false);
+
+/* RFA provider. */
+	provider_.reset (new provider_t (config_, rfa_, event_queue_, store_, &monitor_));
+	if (!(bool)provider_ || !provider_->init())
+		return false;
+
+/* Encode pipeline, without workers the shard thread encodes each batch
+ * itself with the last encoder.
+ */
+	if (config_.encode_threads > 0) {
+		pool_.reset (new encode_pool_t (config_.encode_threads));
+		if (!(bool)pool_)
+			return false;
+	}
+	encoders_.reset (new market_price_store_t::encoder_type[config_.encode_threads + 1]);
+	ring_.reset (new encode_batch_t[ring_size]);
+	if (!(bool)encoders_ || !(bool)ring_)
+		return false;
+	for (size_t i = 0; i < ring_size; ++i)
+		ring_[i].init (&store_, encoders_.get());
+	return true;
+}
+
+/* Intervals round up to whole ticks.  The first publish of each item falls
+ * within its first interval at a phase proportional to its handle, such that
+ * a tier of equal intervals leaves evenly spread rather than in one burst.
+ */
+bool
+nezumi::shard_t::createItemStreams (
+	const std::vector<chromium::StringPiece>& names,
+	const std::vector<uint32_t>& intervals
+	)
+{
+	DCHECK_EQ(names.size(), intervals.size());
+/* Once only, per-handle arrays are sized to the store capacity. */
+	DCHECK_EQ(0U, store_.size());
+	if (!provider_->createItemStreams (names))
+		return false;
+	const size_t capacity = store_.capacity();
+	envelopes_.reset (new stream_envelope_t[capacity]);
+	if (!(bool)envelopes_)
+		return false;
+	const uint64_t resolution_us = config_.timer_resolution_us;
+	schedule_.reserve (capacity);
+	expired_.reserve (capacity);
+	for (size_t i = 0; i < names.size(); ++i) {
+		const item_store_t::handle_t handle = store_.find (names[i]);
+		DCHECK_NE(static_cast<unsigned> (item_store_t::npos), handle);
+		const uint64_t interval_us = 0 == intervals[i] ? 1000 * static_cast<uint64_t> (config_.publish_interval_ms) : intervals[i];
+		const uint64_t ticks = (interval_us + resolution_us - 1) / resolution_us;
+		const uint32_t interval = 0 == ticks ? 1 : static_cast<uint32_t> (ticks);
+		const uint64_t phase = config_.publish_stagger ? (static_cast<uint64_t> (handle) * interval) / capacity : 0;
+		schedule_.schedule (handle, interval, 1 + phase);
+	}
+	for (item_store_t::handle_t handle = 0; handle < capacity; ++handle) {
+		envelopes_[handle].init (store_.name (handle), service_name_);
+/* Static display template, only sent within refresh images. */
+		store_.set<market_price_t::RDNDISPLAY> (handle, 100);
+	}
+	VLOG(2) << "Shard " << id_ << " created " << store_.size() << " item streams.";
+	return true;
+}
+
+/* Consecutive shards land on consecutive processors, with more shards than
+ * processors the assignment wraps.
+ */
+bool
+nezumi::shard_t::start (
+	const boost::chrono::time_point<boost::chrono::system_clock>& origin
+	)
+{
+	if ((bool)pool_ && !pool_->start())
+		return false;
+	if (!doorbell_.init())
+		return false;
+	event_queue_->registerNotificationClient (*this, nullptr);
+/* Tick zero of the timing wheel, shared by every shard. */
+	origin_ = origin;
+	thread_.reset (new boost::thread (config_.reactor_mode ? &shard_t::reactorLoop : &shard_t::mainLoop, this));
+	if (!(bool)thread_)
+		return false;
+	SYSTEM_INFO si;
+	::GetSystemInfo (&si);
+	const size_t processor = id_ % si.dwNumberOfProcessors;
+	const DWORD_PTR mask = static_cast<DWORD_PTR> (1) << processor;
+	if (0 == ::SetThreadAffinityMask (thread_->native_handle(), mask)) {
+		LOG(WARNING) << "Failed to pin shard " << id_ << " to processor " << processor << ", error " << ::GetLastError() << ".";
+	} else {
+		LOG(INFO) << "Shard " << id_ << " pinned to processor " << processor << ".";
+	}
+	return true;
+}
+
+void
+nezumi::shard_t::stop()
+{
+	if ((bool)event_queue_)
+		event_queue_->deactivate();
+	if ((bool)thread_) {
+		doorbell_.ring();
+		thread_->join();
+		thread_.reset();
+		event_queue_->unregisterNotificationClient (*this);
+	}
+/* No batches in flight once the shard thread has exited. */
+	if ((bool)pool_)
+		pool_->stop();
+}
+
+/* Single writer: RFA callbacks and posted commands both execute here.  The
+ * thread sleeps on the doorbell rather than in dispatch, such that a tick
+ * posted by the timer thread runs at once instead of after the dispatch
+ * timeout.
+ */
+void
+nezumi::shard_t::mainLoop()
+{
+	monitor_.attach();
+	while (event_queue_->isActive()) {
+		monitor_.beginDispatch();
+		int pending;
+		size_t queued = 0;
+		while ((pending = event_queue_->dispatch (rfa::common::Dispatchable::NoWait)) >= 0) {
+/* The first dispatch reports what was left behind it. */
+			if (0 == queued)
+				queued = static_cast<size_t> (pending) + 1;
+			if (0 == pending)
+				break;
+		}
+		monitor_.endDispatch (queued);
+		monitor_.beginCommands();
+		monitor_.endCommands (executor_.run());
+		doorbell_.wait (kIdleWaitMs);
+	}
+	logStatistics();
+}
+
+/* Single writer as mainLoop(), timer deadlines bound the doorbell wait in
+ * place of the idle backstop.  Ticks run against the steady clock
+ * from thread start, a late wake turns the wheel to the current tick at once.
+ */
+void
+nezumi::shard_t::reactorLoop()
+{
+	using namespace boost::chrono;
+	const microseconds resolution (config_.timer_resolution_us);
+	const microseconds spin (config_.timer_spin_us);
+	const steady_clock::time_point origin = steady_clock::now();
+	steady_clock::time_point deadline = origin + resolution;
+	monitor_.attach();
+	while (event_queue_->isActive()) {
+/* Drain RFA events then posted commands, neither blocks. */
+		monitor_.beginDispatch();
+		int pending;
+		size_t queued = 0;
+		while ((pending = event_queue_->dispatch (rfa::common::Dispatchable::NoWait)) >= 0) {
+/* The first dispatch reports what was left behind it. */
+			if (0 == queued)
+				queued = static_cast<size_t> (pending) + 1;
+			if (0 == pending)
+				break;
+		}
+		monitor_.endDispatch (queued);
+		monitor_.beginCommands();
+		monitor_.endCommands (executor_.run());
+
+		steady_clock::time_point now = steady_clock::now();
+		if (now >= deadline) {
+			const microseconds lateness = duration_cast<microseconds> (now - deadline);
+			tick_latency_.add (static_cast<uint64_t> (lateness.count()));
+			const uint64_t tick = static_cast<uint64_t> ((now - origin) / resolution);
+			monitor_.beginCommands();
+			publishDue (tick);
+			monitor_.endCommands (1);
+			deadline = origin + resolution * static_cast<microseconds::rep> (tick + 1);
+			now = steady_clock::now();
+			if (now >= deadline)
+				continue;
+		}
+/* Sleep whole milliseconds towards the spin window rounding down, such that
+ * a wait never overshoots the deadline, then poll the doorbell for the
+ * remainder.
+ */
+		const microseconds remaining = duration_cast<microseconds> (deadline - now);
+		const unsigned long sleep_ms = remaining > spin ? static_cast<unsigned long> ((remaining - spin).count() / 1000) : 0;
+		if (sleep_ms > 0) {
+			doorbell_.wait (sleep_ms);
+		} else {
+			while (!doorbell_.poll() && steady_clock::now() < deadline)
+				_mm_pause();
+		}
+	}
+	logStatistics();
+}
+
+void
+nezumi::shard_t::logStatistics()
+{
+	LOG(INFO) << "Shard " << id_ << " executed " << executor_.executed() << " commands"
+		", maximum batch " << executor_.maxBatch() << ".";
+	LOG(INFO) << "Shard " << id_ << " tick latency (us): " << tick_latency_;
+	monitor_.logStatistics();
+/* Items due per timer event, the burst profile at the ADH. */
+	LOG(INFO) << "Shard " << id_ << " slice size: " << slice_sizes_;
+	if ((bool)pool_)
+		LOG(INFO) << "Shard " << id_ << " encode workers stole " << pool_->stolen() << " batches.";
+/* Per-message submit cost against batch size, fixed costs amortise. */
+	for (size_t i = 0; i < submit_buckets; ++i) {
+		const submit_stats_t& stats = submit_stats_[i];
+		if (0 == stats.batches)
+			continue;
+		LOG(INFO) << "Shard " << id_ << " batch size " << (static_cast<size_t> (1) << i) << "+"
+			": " << stats.batches << " batches"
+			", " << (stats.ns / stats.messages) << "ns/msg.";
+	}
+}
+
+/* Timer thread: touch no shard state, only post.
+ */
+void
+nezumi::shard_t::processTimer (
+	const boost::chrono::time_point<boost::chrono::system_clock>& t
+	)
+{
+	chromium::subtle::Barrier_AtomicIncrement (&ticks_in_flight_, 1);
+	post (new tick_command_t (this, t));
+}
+
+void
+nezumi::shard_t::post (
+	command_t* command
+	)
+{
+	executor_.post (command);
+	doorbell_.ring();
+}
+
+/* Rings from within RFA, return promptly. */
+void
+nezumi::shard_t::notify (
+	rfa::common::Dispatchable& eventSource,
+	void* closure
+	)
+{
+	doorbell_.ring();
+}
+
+void
+nezumi::shard_t::processTick (
+	const boost::chrono::time_point<boost::chrono::system_clock>& t
+	)
+{
+/* Timer accuracy plus executor hand-off, typically 15-1ms with default
+ * timer resolution.  Meaningless against simulated time.
+ */
+	if (0 == config_.simulation_seconds) {
+		using namespace boost::chrono;
+		const microseconds delta = duration_cast<microseconds> (system_clock::now() - t);
+		tick_latency_.add (delta.count() > 0 ? static_cast<uint64_t> (delta.count()) : 0);
+	}
+
+/* Late timer events turn the wheel through every elapsed tick at once. */
+	const boost::chrono::microseconds elapsed = boost::chrono::duration_cast<boost::chrono::microseconds> (t - origin_);
+	const uint64_t tick = elapsed_ticks (elapsed.count(), config_.timer_resolution_us);
+	publishDue (tick);
+	chromium::subtle::Barrier_AtomicIncrement (&ticks_in_flight_, -1);
+}
+
+void
+nezumi::shard_t::publishDue (
+	uint64_t tick
+	)
+{
+	expired_.clear();
+	const size_t due = schedule_.advance (tick, &expired_);
+	slice_sizes_.add (due);
+	if (0 == due)
+		return;
+
+	try {
+/* Tokens are settled before encoding as a new token forces a refresh. */
+		bool is_muted = false;
+		for (auto it = expired_.begin(); it != expired_.end(); ++it) {
+			const item_store_t::handle_t handle = *it;
+			store_.set<market_price_t::TRDPRC_1> (handle, store_.nextSequence (handle));
+			if (!is_muted && !provider_->acquireToken (handle))
+				is_muted = true;
+		}
+		if (!is_muted)
+			publishBatches (expired_);
+	} catch (rfa::common::InvalidUsageException& e) {
+		LOG(ERROR) << "InvalidUsageException: { "
+			  "\"Severity\": \"" << severity_string (e.getSeverity()) << "\""
+			", \"Classification\": \"" << classification_string (e.getClassification()) << "\""
+			", \"StatusText\": \"" << e.getStatus().getStatusText() << "\" }";
+	}
+}
+
+nezumi::stream_envelope_t::stream_envelope_t() :
+	refresh (false),	/* reference */
+	update (false),		/* reference */
+	attribInfo_ (false)	/* reference */
+{
+}
+
+/* Populate every message component that is invariant for the lifetime of the
+ * stream, the publish path only attaches the payload.
+ */
+void
+nezumi::stream_envelope_t::init (
+	const RFA_String& name,
+	const RFA_String& service_name
+	)
+{
+/* 7.5.9.5 Create or re-use a request attribute object (4.2.4) */
+	attribInfo_.setNameType (rfa::rdm::INSTRUMENT_NAME_RIC);
+	attribInfo_.setName (name);
+	attribInfo_.setServiceName (service_name);
+
+/* 6.2.8 Quality of Service. */
+/* Timeliness: age of data, either real-time, unspecified delayed timeliness,
+ * unspecified timeliness, or any positive number representing the actual
+ * delay in seconds.
+ */
+	QoS_.setTimeliness (rfa::common::QualityOfService::realTime);
+/* Rate: minimum period of change in data, either tick-by-tick, just-in-time
+ * filtered rate, unspecified rate, or any positive number representing the
+ * actual rate in milliseconds.
+ */
+	QoS_.setRate (rfa::common::QualityOfService::tickByTick);
+
+/* Item interaction state: Open, Closed, ClosedRecover, Redirected, NonStreaming, or Unspecified. */
+	status_.setStreamState (rfa::common::RespStatus::OpenEnum);
+/* Data quality state: Ok, Suspect, or Unspecified. */
+	status_.setDataState (rfa::common::RespStatus::OkEnum);
+/* Error code, e.g. NotFound, InvalidArgument, ... */
+	status_.setStatusCode (rfa::common::RespStatus::NoneEnum);
+
+/* 7.5.9.2 Set the message model type of the response. */
+	refresh.setMsgModelType (rfa::rdm::MMT_MARKET_PRICE);
+/* 7.5.9.3 Set response type. */
+	refresh.setRespType (rfa::message::RespMsg::RefreshEnum);
+	refresh.setIndicationMask (rfa::message::RespMsg::RefreshCompleteFlag);
+/* 7.5.9.4 Set the response type enumation. */
+	refresh.setRespTypeNum (rfa::rdm::REFRESH_UNSOLICITED);
+	refresh.setAttribInfo (attribInfo_);
+	refresh.setQualityOfService (QoS_);
+	refresh.setRespStatus (status_);
+
+	update.setMsgModelType (rfa::rdm::MMT_MARKET_PRICE);
+	update.setRespType (rfa::message::RespMsg::UpdateEnum);
+/* RDM instrument update type. */
+	update.setRespTypeNum (rfa::rdm::INSTRUMENT_UPDATE_UNSPECIFIED);
+	update.setAttribInfo (attribInfo_);
+}
+
+/* 4.2.8 Message Validation.  RFA provides an interface to verify that
+ * constructed messages of these types conform to the Reuters Domain
+ * Models as specified in RFA API 7 RDM Usage Guide.
+ */
+#ifdef DEBUG
+static
+void
+validate_msg (
+	rfa::message::RespMsg& response
+	)
+{
+	RFA_String warningText;
+	const uint8_t validation_status = response.validateMsg (&warningText);
+	if (rfa::message::MsgValidationWarning == validation_status) {
+		LOG(ERROR) << "respMsg::validateMsg: { \"warningText\": \"" << warningText << "\" }";
+	} else {
+		assert (rfa::message::MsgValidationOk == validation_status);
+	}
+}
+#endif
+
+void
+nezumi::shard_t::attachPayload (
+	rfa::data::FieldList& fields,
+	uint8_t* data,
+	size_t length,
+	size_t capacity
+	)
+{
+/* Reference the encoded buffer, RFA copies on submit. */
+	rfa::common::Buffer buffer;
+	buffer.setFrom (data, static_cast<unsigned> (length), static_cast<unsigned> (capacity), false);
+// not std::map :(  derived from rfa::common::Data
+	fields.setAssociatedMetaInfo (provider_->getRwfMajorVersion(), provider_->getRwfMinorVersion());
+	fields.setEncodedBuffer (buffer);
+}
+
+/* Issue spans of due handles into the ring ahead of submission, at most
+ * ring_size batches in flight.  Submission follows issue order so each item
+ * keeps its message order, whilst waiting the shard thread encodes queued
+ * batches itself.  Without workers each span is encoded and submitted in
+ * turn through the first slot.
+ */
+bool
+nezumi::shard_t::publishBatches (
+	const std::vector<item_store_t::handle_t>& handles
+	)
+{
+	const size_t count = handles.size();
+	const size_t batch_count = (count + encode_batch_t::max_items - 1) / encode_batch_t::max_items;
+	if (!(bool)pool_) {
+		encode_batch_t& batch = ring_[0];
+		for (size_t begin = 0; begin < count; begin += encode_batch_t::max_items) {
+			const size_t end = count - begin > encode_batch_t::max_items ? begin + encode_batch_t::max_items : count;
+			batch.reset (&handles[begin], end - begin);
+			batch.encode (config_.encode_threads);
+/* Muted provider, remaining spans retry on next tick. */
+			if (!submitBatch (batch))
+				return false;
+		}
+		return true;
+	}
+	size_t issued = 0, submitted = 0;
+	try {
+		while (submitted < batch_count) {
+			while (issued < batch_count && issued - submitted < ring_size) {
+				const size_t begin = issued * encode_batch_t::max_items;
+				const size_t end = count - begin > encode_batch_t::max_items ? begin + encode_batch_t::max_items : count;
+				encode_batch_t& batch = ring_[issued % ring_size];
+				batch.reset (&handles[begin], end - begin);
+				pool_->submit (&batch);
+				++issued;
+			}
+			encode_batch_t& batch = ring_[submitted % ring_size];
+			waitBatch (batch);
+			++submitted;
+/* Muted provider, remaining batches retry on next tick. */
+			if (!submitBatch (batch))
+				break;
+		}
+	} catch (...) {
+/* Slots must be idle before the ring is reused. */
+		for (; submitted < issued; ++submitted)
+			waitBatch (ring_[submitted % ring_size]);
+		throw;
+	}
+	for (; submitted < issued; ++submitted)
+		waitBatch (ring_[submitted % ring_size]);
+	return submitted == batch_count;
+}
+
+void
+nezumi::shard_t::waitBatch (
+	encode_batch_t& batch
+	)
+{
+	while (!batch.isReady()) {
+		if (!pool_->help())
+			boost::this_thread::yield();
+	}
+}
+
+bool
+nezumi::shard_t::submitBatch (
+	encode_batch_t& batch
+	)
+{
+	const size_t count = batch.size();
+	for (size_t i = 0; i < count; ++i) {
+		const encode_batch_t::message_t& message = batch.message (i);
+		const item_store_t::handle_t handle = message.handle;
+		rfa::message::RespMsg& response = message.is_refresh ? envelopes_[handle].refresh : envelopes_[handle].update;
+/* Each message of the span references its own field list. */
+		attachPayload (batch_fields_[i], batch.payload (i), message.length, encode_batch_t::max_payload);
+		response.setPayload (batch_fields_[i]);
+
+#ifdef DEBUG
+		validate_msg (response);
+#endif
+
+		outbound_[i].handle = handle;
+		outbound_[i].msg = &response;
+	}
+	if (0 == count)
+		return true;
+	using namespace boost::chrono;
+	const steady_clock::time_point start = steady_clock::now();
+	if (!provider_->sendBatch (outbound_, count))
+		return false;
+	size_t bucket = 0;
+	while (bucket + 1 < submit_buckets && (static_cast<size_t> (2) << bucket) <= count)
+		++bucket;
+	submit_stats_t& stats = submit_stats_[bucket];
+	stats.batches++;
+	stats.messages += count;
+	stats.ns += duration_cast<nanoseconds> (steady_clock::now() - start).count();
+	for (size_t i = 0; i < count; ++i) {
+		const encode_batch_t::message_t& message = batch.message (i);
+		if (message.is_refresh) {
+			store_.clearRefreshPending (message.handle);
+			DVLOG(4) << "Sent refresh to stream " << store_.name (message.handle);
+			BLOG_EVERY_T_SUMMARY(INFO, 1, "Sent refresh.") ();
+		}
+		store_.clearDirty (message.handle);
+	}
+	return true;
+}
+
+nezumi::encode_batch_t::encode_batch_t() :
+	store_ (nullptr),
+	encoders_ (nullptr),
+	handle_count_ (0),
+	is_ready_ (0),
+	count_ (0)
+{
+}
+
+void
+nezumi::encode_batch_t::init (
+	const market_price_store_t* store,
+	market_price_store_t::encoder_type* encoders
+	)
+{
+	store_ = store;
+	encoders_ = encoders;
+}
+
+void
+nezumi::encode_batch_t::reset (
+	const item_store_t::handle_t* handles,
+	size_t count
+	)
+{
+	DCHECK_LE(count, static_cast<size_t> (max_items));
+	std::copy (handles, handles + count, handles_);
+	handle_count_ = count;
+	count_ = 0;
+	chromium::subtle::NoBarrier_Store (&is_ready_, 0);
+}
+
+/* Reads hot state of this batch's handles only, the shard thread writes no
+ * item state until the batch is ready.
+ */
+void
+nezumi::encode_batch_t::encode (
+	size_t worker
+	)
+{
+	market_price_store_t::encoder_type& encoder = encoders_[worker];
+	size_t count = 0;
+	for (size_t i = 0; i < handle_count_; ++i) {
+		const item_store_t::handle_t handle = handles_[i];
+		const bool is_refresh = store_->isRefreshPending (handle);
+		const unsigned fields = is_refresh ? static_cast<unsigned> (market_price_store_t::encoder_type::all_fields) : store_->dirty (handle);
+		if (0 == fields)
+			continue;
+		const size_t length = encoder.encode (store_->record (handle), fields, buffer_ + count * max_payload, max_payload);
+		CHECK_GT(length, 0U);
+		messages_[count].handle = handle;
+		messages_[count].is_refresh = is_refresh;
+		messages_[count].length = length;
+		++count;
+	}
+	count_ = count;
+	chromium::subtle::Release_Store (&is_ready_, 1);
+}
+
+/* eof */
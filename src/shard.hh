@@ -0,0 +1,255 @@
+/* Publishing shard.
+ *
+ * A partition of the item universe published through a dedicated RFA
+ * session, connection, provider and event queue.  Each shard owns one thread,
+ * pinned to a processor, which dispatches the shard event queue and executes
+ * posted commands, all item state of the shard is touched by that thread
+ * alone such that shards share nothing on the publish path.
+ *
+ * In reactor mode the same thread also keeps the publish timer: it waits on
+ * a doorbell until the next tick deadline, rung by RFA event notification and
+ * by commands posted from other threads, then dispatches without waiting and
+ * turns the timing wheel inline.
+ */
+
+#ifndef __SHARD_HH__
+#define __SHARD_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+/* RFA 7.2 */
+#include <rfa/rfa.hh>
+
+#include "chromium/string_piece.hh"
+
+#include "config.hh"
+#include "doorbell.hh"
+#include "encode_pool.hh"
+#include "executor.hh"
+#include "histogram.hh"
+#include "item_store.hh"
+#include "market_price.hh"
+#include "provider.hh"
+#include "publish_schedule.hh"
+#include "rwf.hh"
+#include "schema.hh"
+#include "watchdog.hh"
+
+namespace nezumi
+{
+	class rfa_t;
+
+/* Pre-populated message envelope of an item stream, cold state held in an
+ * array parallel to the item store.  Attribute info, QoS and status are set
+ * once at stream creation, RFA references rather than copies these members
+ * so they must outlive the messages.
+ */
+	class stream_envelope_t :
+		boost::noncopyable
+	{
+	public:
+		stream_envelope_t();
+
+		void init (const rfa::common::RFA_String& name, const rfa::common::RFA_String& service_name);
+
+		rfa::message::RespMsg refresh;
+		rfa::message::RespMsg update;
+
+	private:
+		rfa::message::AttribInfo attribInfo_;
+		rfa::common::QualityOfService QoS_;
+		rfa::common::RespStatus status_;
+	};
+
+	typedef record_store_t<market_price_t> market_price_store_t;
+
+/* One slot of the encode ring: a span of due handles encoded by any
+ * worker into a private buffer, then submitted in handle order by the shard
+ * thread.  Readiness is the only state shared between the two.
+ */
+	class encode_batch_t :
+		public encode_task_t,
+		boost::noncopyable
+	{
+	public:
+		enum {
+			max_items	= 128,
+			max_payload	= 256
+		};
+
+		struct message_t
+		{
+			item_store_t::handle_t handle;
+			bool is_refresh;
+			size_t length;
+		};
+
+		encode_batch_t();
+
+/* Shard thread, once before first use. */
+		void init (const market_price_store_t* store, market_price_store_t::encoder_type* encoders);
+/* Shard thread, before each submission to the pool, handles are copied. */
+		void reset (const item_store_t::handle_t* handles, size_t count);
+/* Any worker, encoder selected by worker index. */
+		void encode (size_t worker) override;
+
+		bool isReady() const { return 0 != chromium::subtle::Acquire_Load (&is_ready_); }
+		size_t size() const { return count_; }
+		const message_t& message (size_t i) const { return messages_[i]; }
+		uint8_t* payload (size_t i) { return buffer_ + i * max_payload; }
+
+	private:
+		const market_price_store_t* store_;
+		market_price_store_t::encoder_type* encoders_;
+		item_store_t::handle_t handles_[max_items];
+		size_t handle_count_;
+		volatile chromium::subtle::Atomic32 is_ready_;
+		size_t count_;
+		message_t messages_[max_items];
+		uint8_t buffer_[max_items * max_payload];
+	};
+
+	class shard_t :
+		public rfa::common::DispatchableNotificationClient,
+		boost::noncopyable
+	{
+	public:
+/* Configuration is copied with entity names specific to the shard. */
+		shard_t (size_t id, const config_t& config, std::shared_ptr<rfa_t> rfa);
+		~shard_t();
+
+/* Create event queue and provider, login proceeds once the thread starts. */
+		bool init() throw (rfa::common::InvalidConfigurationException, rfa::common::InvalidUsageException);
+
+/* Create item streams for this partition of the universe, before start().
+ * Intervals in microseconds parallel to names, zero for the default.
+ */
+		bool createItemStreams (const std::vector<chromium::StringPiece>& names, const std::vector<uint32_t>& intervals) throw (rfa::common::InvalidUsageException);
+
+/* Spawn the shard thread pinned to processor id modulo processor count,
+ * origin is tick zero of the timing wheel.
+ */
+		bool start (const boost::chrono::time_point<boost::chrono::system_clock>& origin);
+/* Deactivate the event queue and join the shard thread. */
+		void stop();
+
+/* Any thread, forwards a periodic timer event to the shard thread. */
+		void processTimer (const boost::chrono::time_point<boost::chrono::system_clock>& t);
+/* Any thread, timer events posted and not yet processed. */
+		long ticksInFlight() const { return static_cast<long> (chromium::subtle::Acquire_Load (&ticks_in_flight_)); }
+/* Any thread, the provider has logged in at least once. */
+		bool hasLoggedIn() const { return provider_->hasLoggedIn(); }
+
+/* Any thread, queues a command for execution on the shard thread. */
+		void post (command_t* command);
+
+/* RFA event queue thread, events pending on the shard event queue. */
+		void notify (rfa::common::Dispatchable& eventSource, void* closure);
+
+		size_t id() const { return id_; }
+		loop_monitor_t& monitor() { return monitor_; }
+		size_t size() const { return store_.size(); }
+
+	private:
+		friend class tick_command_t;
+
+/* Turn the timing wheel and publish every due item, shard thread only. */
+		void processTick (const boost::chrono::time_point<boost::chrono::system_clock>& t);
+		void publishDue (uint64_t tick);
+
+/* Shard thread entry points, timer thread driven or reactor. */
+		void mainLoop();
+		void reactorLoop();
+		void logStatistics();
+
+		void attachPayload (rfa::data::FieldList& fields, uint8_t* data, size_t length, size_t capacity);
+
+/* Encode pipeline: workers encode ring slots, this thread submits in order. */
+		bool publishBatches (const std::vector<item_store_t::handle_t>& handles) throw (rfa::common::InvalidUsageException);
+		bool submitBatch (encode_batch_t& batch) throw (rfa::common::InvalidUsageException);
+		void waitBatch (encode_batch_t& batch);
+
+		const size_t id_;
+
+/* Shard configuration, referenced by the provider. */
+		const config_t config_;
+
+/* RFA context, shared by all shards. */
+		std::shared_ptr<rfa_t> rfa_;
+
+/* RFA asynchronous event queue of this shard. */
+		std::shared_ptr<rfa::common::EventQueue> event_queue_;
+
+/* Item streams, shared with the provider. */
+		market_price_store_t store_;
+
+/* Shard thread loop health, fed by the provider callbacks. */
+		loop_monitor_t monitor_;
+
+/* RFA provider */
+		std::shared_ptr<provider_t> provider_;
+
+/* Commands from other threads for execution on the shard thread, the one
+ * thread that dispatches the shard event queue and publishes.
+ */
+		executor_t executor_;
+
+/* Shard thread wake-up for RFA events and posted commands. */
+		doorbell_t doorbell_;
+
+/* Published service name. */
+		rfa::common::RFA_String service_name_;
+
+/* Message envelopes indexed by item handle. */
+		std::unique_ptr<stream_envelope_t[]> envelopes_;
+
+/* Publish schedule in timer ticks. */
+		publish_schedule_t schedule_;
+		std::vector<item_store_t::handle_t> expired_;
+		boost::chrono::time_point<boost::chrono::system_clock> origin_;
+		volatile chromium::subtle::AtomicWord ticks_in_flight_;
+/* Timer due time to tick execution on this thread, microseconds. */
+		histogram_t tick_latency_;
+/* Items due per timer event, maximum is the largest burst. */
+		histogram_t slice_sizes_;
+
+/* Encode workers, none when encoding on the shard thread. */
+		std::unique_ptr<encode_pool_t> pool_;
+/* Encoder per worker plus one for the shard thread, templates build lazily. */
+		std::unique_ptr<market_price_store_t::encoder_type[]> encoders_;
+/* Batches in flight bounded by the ring size. */
+		enum { ring_size = 32 };
+		std::unique_ptr<encode_batch_t[]> ring_;
+/* Per-message payload and submit span of the batch being submitted. */
+		rfa::data::FieldList batch_fields_[encode_batch_t::max_items];
+		outbound_msg_t outbound_[encode_batch_t::max_items];
+
+/* Submit cost by power of two batch size, 1 to max_items. */
+		enum { submit_buckets = 8 };
+		struct submit_stats_t
+		{
+			uint64_t batches;
+			uint64_t messages;
+			uint64_t ns;
+		} submit_stats_[submit_buckets];
+
+		std::unique_ptr<boost::thread> thread_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __SHARD_HH__ */
+
+/* eof */
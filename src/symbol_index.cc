@@ -0,0 +1,150 @@
+/* Flat symbol index of item handles.
+ */
+
+#include "symbol_index.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include "chromium/logging.hh"
+
+/* Arena block size, a typical RIC plus terminator is 8-16 bytes. */
+static const size_t kBlockSize = 64 * 1024;
+
+/* Minimum probe table capacity, must be a power of two. */
+static const size_t kMinimumCapacity = 16;
+
+uint32_t
+nezumi::symbol_hash (
+	const char* name,
+	size_t length
+	)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= static_cast<uint8_t> (name[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+nezumi::symbol_index_t::symbol_index_t() :
+	mask_ (0),
+	block_used_ (0),
+	block_size_ (0)
+{
+	rehash (kMinimumCapacity);
+}
+
+void
+nezumi::symbol_index_t::reserve (
+	size_t count
+	)
+{
+	entries_.reserve (count);
+	size_t capacity = slots_.size();
+	while (capacity < 2 * count)
+		capacity <<= 1;
+	if (capacity != slots_.size())
+		rehash (capacity);
+}
+
+bool
+nezumi::symbol_index_t::insert (
+	const chromium::StringPiece& name,
+	uint32_t handle
+	)
+{
+	const uint32_t hash = symbol_hash (name.data(), name.size());
+	size_t slot = probe (hash, name.data(), name.size());
+	if (0 != slots_[slot])
+		return false;
+/* Grow at half load, probe again as the slot moves. */
+	if (2 * (entries_.size() + 1) > slots_.size()) {
+		rehash (slots_.size() << 1);
+		slot = probe (hash, name.data(), name.size());
+	}
+	entry_t entry;
+	entry.hash = hash;
+	entry.length = static_cast<uint32_t> (name.size());
+	entry.name = intern (name.data(), name.size());
+	entry.handle = handle;
+	entries_.push_back (entry);
+	slots_[slot] = static_cast<uint32_t> (entries_.size());
+	return true;
+}
+
+uint32_t
+nezumi::symbol_index_t::find (
+	const chromium::StringPiece& name
+	) const
+{
+	const uint32_t hash = symbol_hash (name.data(), name.size());
+	const uint32_t index = slots_[probe (hash, name.data(), name.size())];
+	if (0 == index)
+		return npos;
+	return entries_[index - 1].handle;
+}
+
+const char*
+nezumi::symbol_index_t::intern (
+	const char* name,
+	size_t length
+	)
+{
+	const size_t required = length + 1;
+	if (block_size_ - block_used_ < required) {
+		block_size_ = std::max (kBlockSize, required);
+		blocks_.push_back (std::unique_ptr<char[]> (new char[block_size_]));
+		block_used_ = 0;
+	}
+	char* dst = blocks_.back().get() + block_used_;
+	memcpy (dst, name, length);
+	dst[length] = '\0';
+	block_used_ += required;
+	return dst;
+}
+
+void
+nezumi::symbol_index_t::rehash (
+	size_t capacity
+	)
+{
+	DCHECK_EQ(0U, capacity & (capacity - 1));
+	slots_.assign (capacity, 0);
+	mask_ = capacity - 1;
+	for (size_t i = 0; i < entries_.size(); ++i) {
+		size_t slot = entries_[i].hash & mask_;
+		while (0 != slots_[slot])
+			slot = (slot + 1) & mask_;
+		slots_[slot] = static_cast<uint32_t> (i + 1);
+	}
+}
+
+/* Returns the slot holding the symbol, or the empty slot where it would be
+ * inserted.
+ */
+size_t
+nezumi::symbol_index_t::probe (
+	uint32_t hash,
+	const char* name,
+	size_t length
+	) const
+{
+	size_t slot = hash & mask_;
+	while (true) {
+		const uint32_t index = slots_[slot];
+		if (0 == index)
+			return slot;
+		const entry_t& entry = entries_[index - 1];
+		if (entry.hash == hash &&
+		    entry.length == length &&
+		    0 == memcmp (entry.name, name, length))
+		{
+			return slot;
+		}
+		slot = (slot + 1) & mask_;
+	}
+}
+
+/* eof */
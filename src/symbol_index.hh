@@ -0,0 +1,87 @@
+/* Flat symbol index of item handles.
+ *
+ * Entries are held densely for cache-friendly sweeps of the full universe,
+ * an open-addressing table of entry indices with linear probing provides
+ * lookup by symbol.  Symbol names are interned into a block arena and lookups
+ * take a StringPiece, neither allocates per call.
+ *
+ * The universe is fixed for the life of the process, entries are never
+ * erased.
+ */
+
+#ifndef __SYMBOL_INDEX_HH__
+#define __SYMBOL_INDEX_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "chromium/string_piece.hh"
+
+namespace nezumi
+{
+/* FNV-1a, 32-bit. */
+	uint32_t symbol_hash (const char* name, size_t length);
+
+/* Shard of a symbol hash by multiply-shift over the high bits, the index of
+ * each shard probes with the low bits which a modulus would leave identical
+ * for every key of a power-of-two shard count.
+ */
+	inline size_t symbol_shard (uint32_t hash, size_t shard_count) {
+		return static_cast<size_t> ((static_cast<uint64_t> (hash) * shard_count) >> 32);
+	}
+
+	class symbol_index_t :
+		boost::noncopyable
+	{
+	public:
+		enum { npos = 0xffffffffu };
+
+		symbol_index_t();
+
+/* Pre-size for a number of symbols such that bulk insertion does not rehash. */
+		void reserve (size_t count);
+
+/* Returns false if the symbol is already present. */
+		bool insert (const chromium::StringPiece& name, uint32_t handle);
+
+/* npos if absent. */
+		uint32_t find (const chromium::StringPiece& name) const;
+
+		size_t size() const { return entries_.size(); }
+
+	private:
+		struct entry_t {
+			uint32_t hash;
+			uint32_t length;
+			const char* name;
+			uint32_t handle;
+		};
+
+		const char* intern (const char* name, size_t length);
+		void rehash (size_t capacity);
+		size_t probe (uint32_t hash, const char* name, size_t length) const;
+
+/* Live entries, dense. */
+		std::vector<entry_t> entries_;
+/* Probe table of entry index plus one, zero marks an empty slot.  Capacity
+ * is a power of two kept at most half full.
+ */
+		std::vector<uint32_t> slots_;
+		size_t mask_;
+/* Interned names, private to the index. */
+		std::vector<std::unique_ptr<char[]>> blocks_;
+		size_t block_used_;
+		size_t block_size_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __SYMBOL_INDEX_HH__ */
+
+/* eof */
@@ -0,0 +1,53 @@
+/* Periodic timer pump.
+ */
+
+#include "time_pump.hh"
+
+#include <windows.h>
+
+uint64_t
+nezumi::thread_cpu_time_us()
+{
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!::GetThreadTimes (::GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return 0;
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernel_time.dwLowDateTime;
+	kernel.HighPart = kernel_time.dwHighDateTime;
+	user.LowPart = user_time.dwLowDateTime;
+	user.HighPart = user_time.dwHighDateTime;
+/* 100-nanosecond units. */
+	return (kernel.QuadPart + user.QuadPart) / 10;
+}
+
+bool
+nezumi::parse_catchup_policy (
+	const std::string& str,
+	catchup_policy_t* policy
+	)
+{
+	if ("burst" == str)
+		*policy = CATCHUP_BURST;
+	else if ("coalesce" == str)
+		*policy = CATCHUP_COALESCE;
+	else if ("skip" == str)
+		*policy = CATCHUP_SKIP;
+	else
+		return false;
+	return true;
+}
+
+const char*
+nezumi::catchup_policy_string (
+	catchup_policy_t policy
+	)
+{
+	switch (policy) {
+	case CATCHUP_BURST:	return "burst";
+	case CATCHUP_COALESCE:	return "coalesce";
+	case CATCHUP_SKIP:	return "skip";
+	default:		return "unknown";
+	}
+}
+
+/* eof */
@@ -0,0 +1,131 @@
+/* Periodic timer pump.
+ *
+ * A timer thread body raising processTimer() on a time base at a fixed
+ * period of a Boost.Chrono clock, free of RFA such that the virtual clock
+ * may be driven without a provider.
+ */
+
+#ifndef __TIME_PUMP_HH__
+#define __TIME_PUMP_HH__
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "chromium/logging.hh"
+
+#include "clock.hh"
+#include "histogram.hh"
+
+namespace nezumi
+{
+/* Periodic timer event source */
+	template<class Clock, class Duration = typename Clock::duration>
+	class time_base_t
+	{
+	public:
+		virtual bool processTimer (const boost::chrono::time_point<Clock, Duration>& t) = 0;
+	};
+
+/* Handling of ticks missed whilst a callback overran or the thread stalled.
+ */
+	enum catchup_policy_t {
+/* Fire every missed tick back-to-back, complete but bursty. */
+		CATCHUP_BURST,
+/* Fire once immediately for the latest missed tick, then resume. */
+		CATCHUP_COALESCE,
+/* Drop missed ticks and wait for the next future tick, smooth but lossy. */
+		CATCHUP_SKIP
+	};
+
+	bool parse_catchup_policy (const std::string& str, catchup_policy_t* policy);
+	const char* catchup_policy_string (catchup_policy_t policy);
+
+/* User plus kernel time consumed by the calling thread in microseconds. */
+	uint64_t thread_cpu_time_us();
+
+/* With a spin budget the pump sleeps until the budget before the due time
+ * then spins on the steady clock, trading a core for microsecond jitter
+ * beyond the scheduler quantum.  Lateness is always measured on the steady
+ * clock.  On the virtual clock the pump advances time itself.
+ */
+	template<class Clock, class Duration = typename Clock::duration>
+	class time_pump_t
+	{
+	public:
+		time_pump_t (const boost::chrono::time_point<Clock, Duration>& due_time, Duration td, catchup_policy_t policy, boost::chrono::microseconds spin, time_base_t<Clock, Duration>* cb) :
+			due_time_ (due_time),
+			td_ (td),
+			policy_ (policy),
+			spin_ (spin),
+			cb_ (cb),
+			missed_ (0)
+		{
+			CHECK(nullptr != cb_);
+			CHECK(td_.count() > 0);
+		}
+
+		void operator()()
+		{
+			using namespace boost::chrono;
+			const steady_clock::time_point start = steady_clock::now();
+			const uint64_t start_cpu_us = thread_cpu_time_us();
+			try {
+				while (true) {
+/* Wake-up lateness against the due time in microseconds. */
+					const microseconds late = sleep_traits_t<Clock>::sleep_until (due_time_, spin_);
+					lateness_.add (late.count());
+					if (!cb_->processTimer (due_time_))
+						break;
+					due_time_ += td_;
+					catchUp();
+				}
+			} catch (boost::thread_interrupted const&) {
+				LOG(INFO) << "Timer thread interrupted.";
+			}
+			const uint64_t wall_us = duration_cast<microseconds> (steady_clock::now() - start).count();
+			const uint64_t cpu_us = thread_cpu_time_us() - start_cpu_us;
+			LOG(INFO) << "Timer lateness (us): " << lateness_ << ", "
+				<< catchup_policy_string (policy_) << " " << missed_ << " missed ticks.";
+			LOG(INFO) << "Timer CPU " << (cpu_us / 1000) << "ms of " << (wall_us / 1000) << "ms wall"
+				" (" << (0 == wall_us ? 0 : (100 * cpu_us) / wall_us) << "%)"
+				", spin budget " << spin_.count() << "us.";
+		}
+
+	private:
+		void catchUp()
+		{
+			if (CATCHUP_BURST == policy_)
+				return;
+			const boost::chrono::time_point<Clock, Duration> now = Clock::now();
+			if (now < due_time_)
+				return;
+/* Whole periods elapsed beyond the next due time. */
+			typename Duration::rep behind = static_cast<typename Duration::rep> ((now - due_time_) / td_);
+			if (CATCHUP_SKIP == policy_)
+				++behind;
+			due_time_ += td_ * behind;
+			missed_ += static_cast<uint64_t> (behind);
+		}
+
+		boost::chrono::time_point<Clock, Duration> due_time_;
+		Duration td_;
+		catchup_policy_t policy_;
+		boost::chrono::microseconds spin_;
+		time_base_t<Clock, Duration>* cb_;
+
+		histogram_t lateness_;
+		uint64_t missed_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __TIME_PUMP_HH__ */
+
+/* eof */
@@ -0,0 +1,176 @@
+/* Hierarchical timing wheel of item handles.
+ */
+
+#include "timing_wheel.hh"
+
+#include <algorithm>
+
+#include "chromium/logging.hh"
+
+/* Ticks covered by every level together. */
+static const uint64_t kWheelSpan = static_cast<uint64_t> (1) << (nezumi::timing_wheel_t::level_count * nezumi::timing_wheel_t::slot_bits);
+
+nezumi::timing_wheel_t::timing_wheel_t() :
+	now_ (0),
+	size_ (0),
+	heads_ (level_count * slot_count, npos)
+{
+}
+
+void
+nezumi::timing_wheel_t::reserve (
+	size_t count
+	)
+{
+	if (count <= slots_.size())
+		return;
+	next_.resize (count, npos);
+	prev_.resize (count, npos);
+	slots_.resize (count, npos);
+	expiry_.resize (count, 0);
+}
+
+void
+nezumi::timing_wheel_t::schedule (
+	handle_t handle,
+	uint64_t delay
+	)
+{
+	scheduleAt (handle, now_ + std::max (delay, static_cast<uint64_t> (1)));
+}
+
+void
+nezumi::timing_wheel_t::scheduleAt (
+	handle_t handle,
+	uint64_t tick
+	)
+{
+	DCHECK_LT(handle, slots_.size());
+	if (isScheduled (handle))
+		unlink (handle);
+	else
+		++size_;
+	expiry_[handle] = std::max (tick, now_ + 1);
+	insert (handle);
+}
+
+void
+nezumi::timing_wheel_t::cancel (
+	handle_t handle
+	)
+{
+	if (!isScheduled (handle))
+		return;
+	unlink (handle);
+	--size_;
+}
+
+/* Per tick: cascade higher levels when the lower wraps, then empty the due
+ * level zero slot.  An empty wheel jumps straight to the target.
+ */
+size_t
+nezumi::timing_wheel_t::advance (
+	uint64_t tick,
+	std::vector<handle_t>* expired
+	)
+{
+	DCHECK(nullptr != expired);
+	size_t count = 0;
+	while (now_ < tick) {
+		if (0 == size_) {
+			now_ = tick;
+			break;
+		}
+		++now_;
+		if (0 == (now_ & slot_mask))
+			cascade (1);
+		const uint32_t slot = static_cast<uint32_t> (now_ & slot_mask);
+		handle_t handle = heads_[slot];
+		heads_[slot] = npos;
+		while (npos != handle) {
+			const handle_t next = next_[handle];
+			slots_[handle] = npos;
+			expired->push_back (handle);
+			--size_;
+			++count;
+			handle = next;
+		}
+	}
+	return count;
+}
+
+/* Lowest level whose span covers the remaining delay, slot chosen by the
+ * expiry bits of that level.  Delays beyond the wheel park in the top level
+ * and re-evaluate on each cascade.
+ */
+void
+nezumi::timing_wheel_t::insert (
+	handle_t handle
+	)
+{
+	const uint64_t expiry = expiry_[handle];
+	const uint64_t delta = expiry - now_;
+	uint64_t at = expiry;
+	if (delta >= kWheelSpan)
+		at = now_ + kWheelSpan - 1;
+	unsigned level = 0;
+	while (level + 1 < level_count && (at - now_) >= (static_cast<uint64_t> (1) << ((level + 1) * slot_bits)))
+		++level;
+	const uint32_t index = static_cast<uint32_t> ((at >> (level * slot_bits)) & slot_mask);
+	link (level * slot_count + index, handle);
+}
+
+void
+nezumi::timing_wheel_t::link (
+	uint32_t slot,
+	handle_t handle
+	)
+{
+	const handle_t head = heads_[slot];
+	next_[handle] = head;
+	prev_[handle] = npos;
+	if (npos != head)
+		prev_[head] = handle;
+	heads_[slot] = handle;
+	slots_[handle] = slot;
+}
+
+void
+nezumi::timing_wheel_t::unlink (
+	handle_t handle
+	)
+{
+	const handle_t next = next_[handle], prev = prev_[handle];
+	if (npos != prev)
+		next_[prev] = next;
+	else
+		heads_[slots_[handle]] = next;
+	if (npos != next)
+		prev_[next] = prev;
+	slots_[handle] = npos;
+}
+
+/* Re-insert every timer of the current slot of a level, each lands in a
+ * lower level as its remaining delay is now within that span.
+ */
+void
+nezumi::timing_wheel_t::cascade (
+	unsigned level
+	)
+{
+	if (level >= level_count)
+		return;
+	const uint32_t index = static_cast<uint32_t> ((now_ >> (level * slot_bits)) & slot_mask);
+	if (0 == index)
+		cascade (level + 1);
+	const uint32_t slot = level * slot_count + index;
+	handle_t handle = heads_[slot];
+	heads_[slot] = npos;
+	while (npos != handle) {
+		const handle_t next = next_[handle];
+		insert (handle);
+		handle = next;
+	}
+}
+
+/* eof */
@@ -0,0 +1,86 @@
+/* Hierarchical timing wheel of item handles.
+ *
+ * Four levels of 256 slots cover 2^32 ticks, a timer is held in the lowest
+ * level whose span covers its remaining delay and cascades down one level as
+ * the wheel turns, such that schedule and cancel are O(1) and an advance
+ * touches only due slots.  Slots are intrusive doubly-linked lists threaded
+ * through arrays indexed by handle, no allocation is made per timer.
+ *
+ * One timer per handle, scheduling a pending handle moves it.
+ */
+
+#ifndef __TIMING_WHEEL_HH__
+#define __TIMING_WHEEL_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+namespace nezumi
+{
+	class timing_wheel_t :
+		boost::noncopyable
+	{
+	public:
+		typedef uint32_t handle_t;
+		enum { npos = 0xffffffff };
+
+		enum {
+			slot_bits	= 8,
+			slot_count	= 1 << slot_bits,
+			slot_mask	= slot_count - 1,
+			level_count	= 4
+		};
+
+		timing_wheel_t();
+
+/* Handles below count may be scheduled. */
+		void reserve (size_t count);
+
+/* Expire delay ticks from now, a delay of zero expires on the next tick. */
+		void schedule (handle_t handle, uint64_t delay);
+/* Expire at an absolute tick, one not after now expires on the next tick. */
+		void scheduleAt (handle_t handle, uint64_t tick);
+		void cancel (handle_t handle);
+		bool isScheduled (handle_t handle) const { return handle < slots_.size() && npos != slots_[handle]; }
+/* Tick the handle is or was last due, an expired handle keeps its due tick
+ * whilst advance() turns past it.
+ */
+		uint64_t expiry (handle_t handle) const { return expiry_[handle]; }
+
+/* Turn the wheel forward to tick appending every handle due, returns the
+ * count appended.
+ */
+		size_t advance (uint64_t tick, std::vector<handle_t>* expired);
+
+		uint64_t now() const { return now_; }
+		size_t size() const { return size_; }
+
+	private:
+		void insert (handle_t handle);
+		void link (uint32_t slot, handle_t handle);
+		void unlink (handle_t handle);
+		void cascade (unsigned level);
+
+		uint64_t now_;
+		size_t size_;
+
+/* List head per slot, level major. */
+		std::vector<handle_t> heads_;
+
+/* Per handle: links, owning slot or npos, absolute expiry tick. */
+		std::vector<handle_t> next_;
+		std::vector<handle_t> prev_;
+		std::vector<uint32_t> slots_;
+		std::vector<uint64_t> expiry_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __TIMING_WHEEL_HH__ */
+
+/* eof */
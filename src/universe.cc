@@ -0,0 +1,152 @@
+/* Symbol universe loaded from a memory-mapped file.
+ */
+
+#include "universe.hh"
+
+#include <cstring>
+
+#include <windows.h>
+
+#include "chromium/logging.hh"
+
+/* Typical RIC plus line ending, used to pre-size the symbol index from the
+ * file size and avoid re-allocation whilst parsing.
+ */
+static const size_t kAverageLineLength = 10;
+
+nezumi::universe_t::universe_t()
+{
+}
+
+nezumi::universe_t::~universe_t()
+{
+	close();
+}
+
+bool
+nezumi::universe_t::open (
+	const char* path
+	)
+{
+	close();
+
+	file_.reset (CreateFileA (path,
+				  GENERIC_READ,
+				  FILE_SHARE_READ,
+				  nullptr,
+				  OPEN_EXISTING,
+				  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+				  nullptr));
+	if (!file_) {
+		LOG(ERROR) << "CreateFile: { \"path\": \"" << path << "\", \"GetLastError\": " << GetLastError() << " }";
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx (file_.get(), &file_size)) {
+		LOG(ERROR) << "GetFileSizeEx: { \"path\": \"" << path << "\", \"GetLastError\": " << GetLastError() << " }";
+		return false;
+	}
+/* Zero length files cannot be mapped. */
+	if (0 == file_size.QuadPart) {
+		LOG(WARNING) << "Symbol universe \"" << path << "\" is empty.";
+		return true;
+	}
+	mapping_.reset (CreateFileMappingA (file_.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!mapping_) {
+		LOG(ERROR) << "CreateFileMapping: { \"path\": \"" << path << "\", \"GetLastError\": " << GetLastError() << " }";
+		return false;
+	}
+	view_.reset (MapViewOfFile (mapping_.get(), FILE_MAP_READ, 0, 0, 0));
+	if (!view_) {
+		LOG(ERROR) << "MapViewOfFile: { \"path\": \"" << path << "\", \"GetLastError\": " << GetLastError() << " }";
+		return false;
+	}
+	const char* begin = static_cast<const char*> (view_.get());
+	const size_t length = static_cast<size_t> (file_size.QuadPart);
+	symbols_.reserve (length / kAverageLineLength);
+	intervals_.reserve (length / kAverageLineLength);
+	parse (begin, begin + length);
+	return true;
+}
+
+void
+nezumi::universe_t::close()
+{
+	symbols_.clear();
+	intervals_.clear();
+	view_.reset();
+	mapping_.reset();
+	file_.reset();
+}
+
+/* Milliseconds with up to three decimal places, "0.25" yields 250us.  Capped
+ * at roughly one hour.
+ */
+static
+bool
+parse_interval (
+	const char* begin,
+	const char* end,
+	uint32_t* interval_us
+	)
+{
+	uint32_t ms = 0, us = 0, scale = 1000;
+	const char* c = begin;
+	for (; c < end && '.' != *c; ++c) {
+		if (*c < '0' || *c > '9' || ms > 3600000)
+			return false;
+		ms = ms * 10 + (*c - '0');
+	}
+	if (c < end) {
+		for (++c; c < end; ++c) {
+			if (*c < '0' || *c > '9' || scale == 1)
+				return false;
+			scale /= 10;
+			us += (*c - '0') * scale;
+		}
+	}
+	if (ms > 3600000)
+		return false;
+	*interval_us = ms * 1000 + us;
+	return true;
+}
+
+/* Single pass over the view with memchr, trailing whitespace is trimmed such
+ * that "MSFT.O \r\n" yields "MSFT.O" and "MSFT.O\t250" an interval of 250ms.
+ */
+void
+nezumi::universe_t::parse (
+	const char* begin,
+	const char* end
+	)
+{
+	const char* line = begin;
+	while (line < end) {
+		const char* eol = static_cast<const char*> (memchr (line, '\n', end - line));
+		if (nullptr == eol)
+			eol = end;
+		const char* last = eol;
+		while (last > line && (' ' == last[-1] || '\t' == last[-1] || '\r' == last[-1]))
+			--last;
+		while (line < last && (' ' == *line || '\t' == *line))
+			++line;
+		if (line < last && '#' != *line) {
+			const char* symbol_end = line;
+			while (symbol_end < last && ' ' != *symbol_end && '\t' != *symbol_end)
+				++symbol_end;
+			const char* interval = symbol_end;
+			while (interval < last && (' ' == *interval || '\t' == *interval))
+				++interval;
+			uint32_t interval_us = 0;
+			if (interval < last && !parse_interval (interval, last, &interval_us)) {
+				LOG(WARNING) << "Ignoring malformed publish interval for \"" << chromium::StringPiece (line, symbol_end - line) << "\".";
+				interval_us = 0;
+			}
+			symbols_.push_back (chromium::StringPiece (line, symbol_end - line));
+			intervals_.push_back (interval_us);
+		}
+		line = eol + 1;
+	}
+}
+
+/* eof */
@@ -0,0 +1,57 @@
+/* Symbol universe loaded from a memory-mapped file.
+ *
+ * The file is plain text, one RIC per line, blank lines and lines starting
+ * with '#' are ignored and CRLF line endings are accepted.  A RIC may be
+ * followed by whitespace and a publish interval in milliseconds, e.g.
+ * "VOD.L 100" or "ESH4 0.25", otherwise the configured default applies.
+ * Symbols reference the mapped view directly so no per-symbol allocation is
+ * made, they remain valid until close().
+ */
+
+#ifndef __UNIVERSE_HH__
+#define __UNIVERSE_HH__
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+#include "chromium/string_piece.hh"
+#include "microsoft/unique_handle.hh"
+
+namespace nezumi
+{
+	class universe_t :
+		boost::noncopyable
+	{
+	public:
+		universe_t();
+		~universe_t();
+
+/* Map the file and index every symbol, returns false on any I/O failure. */
+		bool open (const char* path);
+		void close();
+
+		const std::vector<chromium::StringPiece>& symbols() const { return symbols_; }
+/* Publish interval in microseconds parallel to symbols(), zero for default. */
+		const std::vector<uint32_t>& intervals() const { return intervals_; }
+		size_t size() const { return symbols_.size(); }
+
+	private:
+		void parse (const char* begin, const char* end);
+
+		ms::file_handle file_;
+		ms::handle mapping_;
+		ms::map_view view_;
+		std::vector<chromium::StringPiece> symbols_;
+		std::vector<uint32_t> intervals_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __UNIVERSE_HH__ */
+
+/* eof */
@@ -0,0 +1,242 @@
+/* Event loop health monitoring.
+ */
+
+#include "watchdog.hh"
+
+#include <windows.h>
+
+#include "chromium/debug/stack_trace.hh"
+#include "chromium/logging.hh"
+
+/* Default thread stack reservation, deeper stacks are reported by the
+ * instruction pointer alone.
+ */
+static const size_t kMaxStackCopy = 1024 * 1024;
+
+/* GetTickCount() value of a busy period, zero is reserved for idle. */
+static inline
+uint32_t
+busy_tick()
+{
+	const uint32_t now = ::GetTickCount();
+	return 0 == now ? 1 : now;
+}
+
+nezumi::loop_monitor_t::loop_monitor_t (
+	const std::string& name
+	) :
+	name_ (name),
+	thread_ (nullptr),
+	stack_base_ (nullptr),
+	busy_since_ (0),
+	stalled_since_ (0),
+	stalls_ (0),
+	has_dispatched_ (false),
+	events_ (0)
+{
+}
+
+nezumi::loop_monitor_t::~loop_monitor_t()
+{
+	if (nullptr != thread_)
+		::CloseHandle (static_cast<HANDLE> (thread_));
+}
+
+bool
+nezumi::loop_monitor_t::attach()
+{
+	DCHECK(nullptr == thread_);
+	HANDLE thread;
+	if (!::DuplicateHandle (::GetCurrentProcess(), ::GetCurrentThread(),
+				::GetCurrentProcess(), &thread,
+				THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+				FALSE, 0))
+	{
+		LOG(WARNING) << "DuplicateHandle: { \"GetLastError\": " << ::GetLastError() << " }";
+		return false;
+	}
+	stack_base_ = reinterpret_cast<const NT_TIB*> (::NtCurrentTeb())->StackBase;
+	thread_ = thread;
+	return true;
+}
+
+void
+nezumi::loop_monitor_t::beginDispatch()
+{
+	if (has_dispatched_) {
+		using namespace boost::chrono;
+		gap_us_.add (duration_cast<microseconds> (steady_clock::now() - dispatch_end_).count());
+	}
+	events_ = 0;
+}
+
+void
+nezumi::loop_monitor_t::endDispatch (
+	size_t queued
+	)
+{
+	dispatch_end_ = boost::chrono::steady_clock::now();
+	has_dispatched_ = true;
+	if (events_ > 0)
+		events_per_wake_.add (events_);
+	if (queued > 0)
+		queue_depth_.add (static_cast<uint64_t> (queued));
+}
+
+/* The watchdog reads busy_since_ before thread_, publish with release. */
+void
+nezumi::loop_monitor_t::beginBusy()
+{
+	busy_start_ = boost::chrono::steady_clock::now();
+	chromium::subtle::Release_Store (&busy_since_, busy_tick());
+}
+
+uint64_t
+nezumi::loop_monitor_t::endBusy()
+{
+	chromium::subtle::Release_Store (&busy_since_, 0);
+	using namespace boost::chrono;
+	return duration_cast<microseconds> (steady_clock::now() - busy_start_).count();
+}
+
+void
+nezumi::loop_monitor_t::logStatistics() const
+{
+	LOG(INFO) << name_ << " callback service time (us): " << callback_us_;
+	LOG(INFO) << name_ << " command service time (us): " << command_us_;
+	LOG(INFO) << name_ << " dispatch gap (us): " << gap_us_;
+	LOG(INFO) << name_ << " events per wake-up: " << events_per_wake_;
+	LOG(INFO) << name_ << " queue depth at wake-up: " << queue_depth_;
+	LOG(INFO) << name_ << " stalls: " << chromium::subtle::NoBarrier_Load (&stalls_);
+}
+
+nezumi::watchdog_t::watchdog_t (
+	unsigned threshold_ms
+	) :
+	threshold_ms_ (threshold_ms)
+{
+}
+
+nezumi::watchdog_t::~watchdog_t()
+{
+	stop();
+}
+
+bool
+nezumi::watchdog_t::start()
+{
+	DCHECK_GT(threshold_ms_, 0U);
+/* Symbol handler initialisation allocates, never whilst a thread is suspended. */
+	chromium::debug::StackTrace::InitializeSymbols();
+	stack_copy_.reset (new uint8_t[kMaxStackCopy]);
+	thread_.reset (new boost::thread (&watchdog_t::run, this));
+	return (bool)thread_;
+}
+
+void
+nezumi::watchdog_t::stop()
+{
+	if (!(bool)thread_)
+		return;
+	thread_->interrupt();
+	thread_->join();
+	thread_.reset();
+}
+
+void
+nezumi::watchdog_t::add (
+	loop_monitor_t* monitor
+	)
+{
+	chromium::AutoLock locked (lock_);
+	monitors_.push_back (monitor);
+}
+
+void
+nezumi::watchdog_t::remove (
+	loop_monitor_t* monitor
+	)
+{
+	chromium::AutoLock locked (lock_);
+	for (auto it = monitors_.begin(); it != monitors_.end(); ++it) {
+		if (*it == monitor) {
+			monitors_.erase (it);
+			break;
+		}
+	}
+}
+
+void
+nezumi::watchdog_t::run()
+{
+	const unsigned period_ms = threshold_ms_ < 4 ? 1 : threshold_ms_ / 4;
+	try {
+		for (;;) {
+			boost::this_thread::sleep_for (boost::chrono::milliseconds (period_ms));
+			chromium::AutoLock locked (lock_);
+			for (auto it = monitors_.begin(); it != monitors_.end(); ++it)
+				check (*it);
+		}
+	} catch (boost::thread_interrupted const&) {
+		VLOG(1) << "Watchdog thread interrupted.";
+	}
+}
+
+/* One report per busy period, identified by its start tick. */
+void
+nezumi::watchdog_t::check (
+	loop_monitor_t* monitor
+	)
+{
+	const uint32_t since = chromium::subtle::Acquire_Load (&monitor->busy_since_);
+	if (0 != monitor->stalled_since_ && since != monitor->stalled_since_) {
+		LOG(INFO) << monitor->name() << " resumed after stall.";
+		monitor->stalled_since_ = 0;
+	}
+	if (0 == since || since == monitor->stalled_since_)
+		return;
+	const uint32_t busy_ms = ::GetTickCount() - since;
+	if (busy_ms < threshold_ms_)
+		return;
+	monitor->stalled_since_ = since;
+	chromium::subtle::NoBarrier_Store (&monitor->stalls_, chromium::subtle::NoBarrier_Load (&monitor->stalls_) + 1);
+	captureStack (monitor, busy_ms);
+}
+
+/* Nothing may allocate, log, read an unwind table or enter DbgHelp whilst
+ * the loop thread is suspended, it may hold the heap, loader, function table
+ * or logging lock.  Only the context and the stack are copied, the unwind
+ * and symbols run on the copy after resume.
+ */
+void
+nezumi::watchdog_t::captureStack (
+	loop_monitor_t* monitor,
+	uint32_t busy_ms
+	)
+{
+	const HANDLE thread = static_cast<HANDLE> (monitor->thread_);
+	if (nullptr == thread) {
+		LOG(WARNING) << monitor->name() << " stalled, busy " << busy_ms << "ms.";
+		return;
+	}
+	if (static_cast<DWORD> (-1) == ::SuspendThread (thread)) {
+		const DWORD error = ::GetLastError();
+		LOG(WARNING) << monitor->name() << " stalled, busy " << busy_ms << "ms, SuspendThread failed, error " << error << ".";
+		return;
+	}
+	CONTEXT context;
+	ZeroMemory (&context, sizeof (context));
+	context.ContextFlags = CONTEXT_FULL;
+	if (!::GetThreadContext (thread, &context)) {
+		const DWORD error = ::GetLastError();
+		::ResumeThread (thread);
+		LOG(WARNING) << monitor->name() << " stalled, busy " << busy_ms << "ms, GetThreadContext failed, error " << error << ".";
+		return;
+	}
+	const size_t stack_size = chromium::debug::StackTrace::CopyStack (&context, monitor->stack_base_, stack_copy_.get(), kMaxStackCopy);
+	::ResumeThread (thread);
+	const chromium::debug::StackTrace trace (&context, stack_copy_.get(), stack_size);
+	LOG(WARNING) << monitor->name() << " stalled, busy " << busy_ms << "ms.\n" << trace.ToString();
+}
+
+/* eof */
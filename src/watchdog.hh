@@ -0,0 +1,159 @@
+/* Event loop health monitoring.
+ *
+ * A loop monitor is fed by the thread it describes: service time of each RFA
+ * callback and posted command batch, the gap between successive dispatch
+ * calls, events handled per wake-up and the event queue depth at wake-up.
+ * Statistics are plain histograms touched by that thread alone.
+ *
+ * Whilst the loop thread is busy it publishes the start of the busy period
+ * through an atomic, the watchdog thread samples every registered monitor
+ * and flags a loop busy beyond the threshold as stalled, capturing the stack
+ * of the stalled thread once per stall.
+ */
+
+#ifndef __WATCHDOG_HH__
+#define __WATCHDOG_HH__
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost noncopyable base class */
+#include <boost/utility.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "chromium/atomicops.hh"
+#include "chromium/synchronization/lock.hh"
+#include "histogram.hh"
+
+namespace nezumi
+{
+	class loop_monitor_t :
+		boost::noncopyable
+	{
+	public:
+		explicit loop_monitor_t (const std::string& name);
+
+		~loop_monitor_t();
+
+/* Loop thread, identifies the thread for stack capture by the watchdog. */
+		bool attach();
+
+/* Loop thread, brackets each non-blocking drain of the event queue.
+ * queued is the count of events waiting when the drain began, zero when the
+ * queue was empty.
+ */
+		void beginDispatch();
+		void endDispatch (size_t queued);
+
+/* Loop thread, brackets a unit of work: an RFA callback or a run of posted
+ * commands.  Nesting is not supported.
+ */
+		void beginCallback() { beginBusy(); }
+		void endCallback() { callback_us_.add (endBusy()); ++events_; }
+		void beginCommands() { beginBusy(); }
+		void endCommands (size_t executed) {
+			const uint64_t us = endBusy();
+			if (executed > 0) command_us_.add (us);
+		}
+
+/* Loop thread, after exit. */
+		void logStatistics() const;
+
+		const std::string& name() const { return name_; }
+
+/* Scoped callback bracket, tolerates a null monitor. */
+		class callback_scope_t :
+			boost::noncopyable
+		{
+		public:
+			explicit callback_scope_t (loop_monitor_t* monitor) : monitor_ (monitor) {
+				if (nullptr != monitor_) monitor_->beginCallback();
+			}
+			~callback_scope_t() {
+				if (nullptr != monitor_) monitor_->endCallback();
+			}
+		private:
+			loop_monitor_t* monitor_;
+		};
+
+	private:
+		friend class watchdog_t;
+
+		void beginBusy();
+		uint64_t endBusy();
+
+		const std::string name_;
+
+/* Duplicated handle of the loop thread, null before attach(), closed with
+ * the monitor as the watchdog may sample after the loop exits.
+ */
+		void* thread_;
+/* Highest address of the loop thread stack, from its TEB. */
+		const void* stack_base_;
+
+/* Start of the current busy period in GetTickCount() milliseconds, zero
+ * whilst idle or blocked in dispatch.  Written by the loop thread.
+ */
+		volatile chromium::subtle::Atomic32 busy_since_;
+/* Busy period flagged as stalled, watchdog thread only. */
+		uint32_t stalled_since_;
+		volatile chromium::subtle::Atomic32 stalls_;
+
+		boost::chrono::steady_clock::time_point busy_start_;
+		boost::chrono::steady_clock::time_point dispatch_end_;
+		bool has_dispatched_;
+		uint64_t events_;
+
+/* Microseconds per RFA callback and per run of posted commands. */
+		histogram_t callback_us_;
+		histogram_t command_us_;
+/* Microseconds from the return of one dispatch to the next call. */
+		histogram_t gap_us_;
+/* Callbacks handled per drain and events waiting when a drain found any. */
+		histogram_t events_per_wake_;
+		histogram_t queue_depth_;
+	};
+
+	class watchdog_t :
+		boost::noncopyable
+	{
+	public:
+/* Stall when busy for threshold_ms or more, sampled at a quarter of it. */
+		explicit watchdog_t (unsigned threshold_ms);
+		~watchdog_t();
+
+		bool start();
+		void stop();
+
+/* Any thread, the monitor must outlive its registration. */
+		void add (loop_monitor_t* monitor);
+		void remove (loop_monitor_t* monitor);
+
+	private:
+		void run();
+		void check (loop_monitor_t* monitor);
+		void captureStack (loop_monitor_t* monitor, uint32_t busy_ms);
+
+		const unsigned threshold_ms_;
+		chromium::Lock lock_;
+		std::vector<loop_monitor_t*> monitors_;
+/* Stack copy of a suspended thread, allocated up front as nothing may
+ * allocate whilst the thread is suspended.
+ */
+		std::unique_ptr<uint8_t[]> stack_copy_;
+		std::unique_ptr<boost::thread> thread_;
+	};
+
+} /* namespace nezumi */
+
+#endif /* __WATCHDOG_HH__ */
+
+/* eof */
@@ -0,0 +1,128 @@
+/* Multi-producer stress test of the single-writer command executor.
+ *
+ * Producers post numbered commands concurrently whilst the owner thread runs
+ * the queue, every command must execute exactly once and in post order per
+ * producer.  Build with a thread sanitizer where the toolchain has one.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Boost threading. */
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "executor.hh"
+
+using namespace nezumi;
+
+static const int kProducers = 4;
+static const long kCommands = 250000;
+
+namespace
+{
+	struct sequence_t
+	{
+		long last;
+		int64_t sum;
+		long out_of_order;
+	};
+
+	class numbered_command_t : public command_t
+	{
+	public:
+		numbered_command_t (sequence_t* sequence, long value) :
+			sequence_ (sequence),
+			value_ (value)
+		{
+		}
+
+		void execute() override {
+			if (value_ != sequence_->last + 1)
+				++sequence_->out_of_order;
+			sequence_->last = value_;
+			sequence_->sum += value_;
+		}
+
+	private:
+		sequence_t* sequence_;
+		long value_;
+	};
+
+/* Counts deletions to verify pending commands are reclaimed. */
+	class counted_command_t : public command_t
+	{
+	public:
+		explicit counted_command_t (int* deleted) : deleted_ (deleted) {}
+		~counted_command_t() { ++*deleted_; }
+		void execute() override {}
+	private:
+		int* deleted_;
+	};
+
+	void produce (executor_t* executor, sequence_t* sequence) {
+		for (long i = 1; i <= kCommands; ++i)
+			executor->post (new numbered_command_t (sequence, i));
+	}
+} /* anonymous namespace */
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	int failures = 0;
+	{
+		executor_t executor;
+		std::vector<sequence_t> sequences (kProducers);
+		for (int p = 0; p < kProducers; ++p) {
+			sequences[p].last = 0;
+			sequences[p].sum = 0;
+			sequences[p].out_of_order = 0;
+		}
+		boost::thread_group producers;
+		for (int p = 0; p < kProducers; ++p)
+			producers.create_thread (boost::bind (&produce, &executor, &sequences[p]));
+		const uint64_t expected = static_cast<uint64_t> (kProducers) * kCommands;
+		uint64_t total = 0;
+		while (total < expected)
+			total += executor.run();
+		producers.join_all();
+		if (0 != executor.run()) {
+			fprintf (stderr, "Commands executed beyond those posted.\n");
+			++failures;
+		}
+		for (int p = 0; p < kProducers; ++p) {
+			const int64_t sum = static_cast<int64_t> (kCommands) * (kCommands + 1) / 2;
+			if (sequences[p].out_of_order > 0 || sequences[p].last != kCommands || sequences[p].sum != sum) {
+				fprintf (stderr, "Producer %d: last %ld, %ld out of order.\n", p, sequences[p].last, sequences[p].out_of_order);
+				++failures;
+			}
+		}
+		printf ("Executed %llu commands, largest batch %u.\n",
+			static_cast<unsigned long long> (executor.executed()),
+			static_cast<unsigned> (executor.maxBatch()));
+	}
+
+/* Pending commands are deleted with the executor. */
+	int deleted = 0;
+	{
+		executor_t executor;
+		executor.post (new counted_command_t (&deleted));
+		executor.post (new counted_command_t (&deleted));
+	}
+	if (2 != deleted) {
+		fprintf (stderr, "%d of 2 pending commands deleted.\n", deleted);
+		++failures;
+	}
+
+	if (failures > 0)
+		return EXIT_FAILURE;
+	puts ("executor_test passed.");
+	return EXIT_SUCCESS;
+}
+
+/* eof */
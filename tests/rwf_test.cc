@@ -0,0 +1,241 @@
+/* RWF encoder and decoder round-trip test.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "field_template.hh"
+#include "rwf.hh"
+
+using namespace nezumi;
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+static
+void
+test_field_list()
+{
+	uint8_t buffer[1024];
+	rwf::field_list_encoder_t encoder (buffer, sizeof (buffer));
+	encoder.init (1, 3);
+	encoder.addUInt (2, 100);
+	encoder.addReal (6, -12345, rwf::EXPONENT_2);
+	encoder.addAscii (3, "MSFT.O", 6);
+	encoder.addUInt (4, 0);
+	encoder.addUInt (5, UINT64_MAX);
+	encoder.addReal (7, INT64_MIN, rwf::EXPONENT0);
+	const size_t length = encoder.complete();
+	EXPECT(length > 0);
+
+	rwf::field_list_decoder_t decoder (buffer, length);
+	EXPECT(decoder.init());
+	EXPECT(1 == decoder.dictionaryId());
+	EXPECT(3 == decoder.fieldListNum());
+	EXPECT(6 == decoder.count());
+
+	rwf::field_entry_t entry;
+	uint64_t uint_value;
+	int64_t mantissa;
+	uint8_t hint;
+	EXPECT(decoder.next (&entry) && 2 == entry.fid);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && 100 == uint_value);
+	EXPECT(decoder.next (&entry) && 6 == entry.fid);
+	EXPECT(rwf::decode_real (entry.data, entry.length, &mantissa, &hint));
+	EXPECT(-12345 == mantissa && rwf::EXPONENT_2 == hint);
+	EXPECT(decoder.next (&entry) && 3 == entry.fid);
+	EXPECT(6 == entry.length && 0 == memcmp (entry.data, "MSFT.O", 6));
+	EXPECT(decoder.next (&entry) && 4 == entry.fid);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && 0 == uint_value);
+	EXPECT(decoder.next (&entry) && 5 == entry.fid);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && UINT64_MAX == uint_value);
+	EXPECT(decoder.next (&entry) && 7 == entry.fid);
+	EXPECT(rwf::decode_real (entry.data, entry.length, &mantissa, &hint) && INT64_MIN == mantissa);
+	EXPECT(!decoder.next (&entry));
+
+/* Running out of space latches. */
+	uint8_t small[8];
+	rwf::field_list_encoder_t overflow (small, sizeof (small));
+	overflow.init (1, 3);
+	overflow.addUInt (2, 1);
+	overflow.addUInt (2, 1);
+	EXPECT(0 == overflow.complete());
+}
+
+static
+void
+test_element_list()
+{
+	uint8_t buffer[1024];
+	rwf::element_list_encoder_t encoder (buffer, sizeof (buffer));
+	encoder.init();
+	encoder.addAscii ("Name", "NI_VTA", 6);
+	encoder.addUInt ("ServiceState", 1);
+	encoder.addReal ("Factor", 5, rwf::EXPONENT0);
+	const size_t length = encoder.complete();
+	EXPECT(length > 0);
+
+	rwf::element_list_decoder_t decoder (buffer, length);
+	EXPECT(decoder.init());
+	EXPECT(3 == decoder.count());
+
+	rwf::element_entry_t entry;
+	uint64_t uint_value;
+	int64_t mantissa;
+	uint8_t hint;
+	EXPECT(decoder.next (&entry));
+	EXPECT(4 == entry.name_length && 0 == memcmp (entry.name, "Name", 4));
+	EXPECT(rwf::DT_ASCII_STRING == entry.data_type && 6 == entry.length);
+	EXPECT(decoder.next (&entry) && rwf::DT_UINT == entry.data_type);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && 1 == uint_value);
+	EXPECT(decoder.next (&entry) && rwf::DT_REAL == entry.data_type);
+	EXPECT(rwf::decode_real (entry.data, entry.length, &mantissa, &hint) && 5 == mantissa);
+	EXPECT(!decoder.next (&entry));
+}
+
+/* Nested field lists with short and long u16ob length prefixes. */
+static
+void
+test_map()
+{
+	uint8_t buffer[4096];
+	rwf::map_encoder_t encoder (buffer, sizeof (buffer));
+	encoder.init (rwf::DT_FIELD_LIST, 3);
+	encoder.beginEntry (rwf::MAP_ADD, "A", 1);
+	{
+		rwf::field_list_encoder_t nested (encoder.pos(), encoder.remaining());
+		nested.init (1, 3);
+		nested.addUInt (2, 7);
+		encoder.endEntry (nested.complete());
+	}
+	char text[300];
+	memset (text, 'x', sizeof (text));
+	encoder.beginEntry (rwf::MAP_UPDATE, "BB", 2);
+	{
+		rwf::field_list_encoder_t nested (encoder.pos(), encoder.remaining());
+		nested.init (1, 3);
+		nested.addAscii (3, text, sizeof (text));
+		encoder.endEntry (nested.complete());
+	}
+	encoder.addDelete ("C", 1);
+	const size_t length = encoder.complete();
+	EXPECT(length > 0);
+
+	rwf::map_decoder_t decoder (buffer, length);
+	EXPECT(decoder.init());
+	EXPECT(3 == decoder.count() && 3 == decoder.totalCountHint());
+	EXPECT(rwf::DT_FIELD_LIST == decoder.containerType());
+	EXPECT(rwf::DT_ASCII_STRING == decoder.keyType());
+
+	rwf::map_entry_t entry;
+	rwf::field_entry_t field;
+	uint64_t uint_value;
+	EXPECT(decoder.next (&entry) && rwf::MAP_ADD == entry.action && 1 == entry.key_length);
+	{
+		rwf::field_list_decoder_t nested (entry.data, entry.length);
+		EXPECT(nested.init() && nested.next (&field));
+		EXPECT(rwf::decode_uint (field.data, field.length, &uint_value) && 7 == uint_value);
+	}
+	EXPECT(decoder.next (&entry) && rwf::MAP_UPDATE == entry.action && 2 == entry.key_length);
+	{
+		rwf::field_list_decoder_t nested (entry.data, entry.length);
+		EXPECT(nested.init() && nested.next (&field));
+		EXPECT(sizeof (text) == field.length);
+	}
+	EXPECT(decoder.next (&entry) && rwf::MAP_DELETE == entry.action && 0 == entry.length);
+	EXPECT(!decoder.next (&entry));
+}
+
+static
+void
+test_primitives()
+{
+	static const uint32_t u30[] = { 0, 0x3f, 0x40, 0x3fff, 0x4000, 0x3fffff, 0x400000, 0x3fffffff };
+	for (size_t i = 0; i < sizeof (u30) / sizeof (u30[0]); ++i) {
+		uint8_t buffer[8];
+		rwf::writer_t writer (buffer, sizeof (buffer));
+		writer.putU30rb (u30[i]);
+		rwf::reader_t reader (buffer, writer.size());
+		uint32_t value;
+		EXPECT(reader.getU30rb (&value) && u30[i] == value);
+	}
+	static const int64_t ints[] = { 0, -1, 127, 128, -128, -129, 32767, 1LL << 40, -(1LL << 40), INT64_MAX, INT64_MIN };
+	for (size_t i = 0; i < sizeof (ints) / sizeof (ints[0]); ++i) {
+		uint8_t buffer[8];
+		rwf::writer_t writer (buffer, sizeof (buffer));
+		writer.putInt (ints[i]);
+		EXPECT(rwf::int_length (ints[i]) == writer.size());
+		int64_t value;
+		EXPECT(rwf::decode_int (buffer, writer.size(), &value) && ints[i] == value);
+	}
+}
+
+/* Patched fixed width slots decode identically to minimal encodings. */
+static
+void
+test_field_template()
+{
+	field_template_t layout (1, 3);
+	const unsigned bid = layout.addUInt (22);
+	const unsigned display = layout.addUInt (2);
+	const unsigned last = layout.addReal (6, rwf::EXPONENT_2);
+	layout.complete();
+	EXPECT(3 == layout.count());
+/* Header with a single byte dictionary id, three FID and length prefixes,
+ * two UInt slots and one Real.
+ */
+	EXPECT(7 + 3 * 3 + 2 * field_template_t::kUIntSlotWidth + field_template_t::kRealSlotWidth == layout.size());
+
+	uint8_t buffer[256];
+	layout.write (buffer);
+	layout.setUInt (buffer, bid, 12345);
+	layout.setUInt (buffer, display, 100);
+	layout.setReal (buffer, last, -4200);
+
+	rwf::field_list_decoder_t decoder (buffer, layout.size());
+	EXPECT(decoder.init());
+	EXPECT(1 == decoder.dictionaryId() && 3 == decoder.fieldListNum());
+	EXPECT(3 == decoder.count());
+	rwf::field_entry_t entry;
+	uint64_t uint_value;
+	int64_t mantissa;
+	uint8_t hint;
+	EXPECT(decoder.next (&entry) && 22 == entry.fid);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && 12345 == uint_value);
+	EXPECT(decoder.next (&entry) && 2 == entry.fid);
+	EXPECT(rwf::decode_uint (entry.data, entry.length, &uint_value) && 100 == uint_value);
+	EXPECT(decoder.next (&entry) && 6 == entry.fid);
+	EXPECT(rwf::decode_real (entry.data, entry.length, &mantissa, &hint));
+	EXPECT(-4200 == mantissa && rwf::EXPONENT_2 == hint);
+	EXPECT(!decoder.next (&entry));
+}
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	test_field_list();
+	test_element_list();
+	test_map();
+	test_primitives();
+	test_field_template();
+	if (failures > 0) {
+		fprintf (stderr, "%d failures.\n", failures);
+		return EXIT_FAILURE;
+	}
+	puts ("rwf_test passed.");
+	return EXIT_SUCCESS;
+}
+
+/* eof */
@@ -0,0 +1,146 @@
+/* Simulation test: the publish schedule driven through the virtual clock.
+ *
+ * A time pump on virtual_clock_t raises every tick of a fixed number of
+ * virtual seconds, each tick turns a publish schedule as shard_t::
+ * publishDue() and steps the sequence of every due item.  Counts, publish
+ * ticks and final sequences must match the schedule exactly and two runs
+ * must produce the same trace.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "clock.hh"
+#include "publish_schedule.hh"
+#include "time_pump.hh"
+
+using namespace nezumi;
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+static const uint64_t kResolutionUs = 1000;
+static const int kSeconds = 10;
+/* Ticks raised, from tick zero at the origin up to the end exclusive. */
+static const uint64_t kTicks = kSeconds * 1000000 / kResolutionUs;
+
+/* Publish interval in ticks per handle, staggered as shard_t. */
+static const uint32_t kIntervals[] = { 1, 2, 3, 7, 10, 100, 250, 1000, 5000, 20000 };
+static const size_t kCount = sizeof (kIntervals) / sizeof (kIntervals[0]);
+
+namespace
+{
+	class simulation_t :
+		public time_base_t<virtual_clock_t>
+	{
+	public:
+		explicit simulation_t (const virtual_clock_t::time_point& origin) :
+			origin_ (origin),
+			sequences_ (kCount, 0),
+			firsts_ (kCount, 0),
+			is_ordered_ (true)
+		{
+			schedule_.reserve (kCount);
+			for (size_t i = 0; i < kCount; ++i) {
+				const uint64_t phase = (static_cast<uint64_t> (i) * kIntervals[i]) / kCount;
+				firsts_[i] = 1 + phase;
+				schedule_.schedule (static_cast<publish_schedule_t::handle_t> (i), kIntervals[i], firsts_[i]);
+			}
+		}
+
+		bool processTimer (const boost::chrono::time_point<virtual_clock_t>& t) override {
+			using namespace boost::chrono;
+			const microseconds elapsed = duration_cast<microseconds> (t - origin_);
+			if (elapsed >= seconds (kSeconds))
+				return false;
+			const uint64_t tick = elapsed_ticks (elapsed.count(), kResolutionUs);
+			expired_.clear();
+			schedule_.advance (tick, &expired_);
+			for (auto it = expired_.begin(); it != expired_.end(); ++it) {
+/* Every publish lands on the next tick of the handle's own period. */
+				const uint64_t due = firsts_[*it] + sequences_[*it] * kIntervals[*it];
+				if (due != tick)
+					is_ordered_ = false;
+				++sequences_[*it];
+				trace_.push_back ((tick << 8) | *it);
+			}
+			return true;
+		}
+
+		const std::vector<uint64_t>& sequences() const { return sequences_; }
+		const std::vector<uint64_t>& firsts() const { return firsts_; }
+		const std::vector<uint64_t>& trace() const { return trace_; }
+		bool isOrdered() const { return is_ordered_; }
+
+	private:
+		const virtual_clock_t::time_point origin_;
+		publish_schedule_t schedule_;
+		std::vector<publish_schedule_t::handle_t> expired_;
+		std::vector<uint64_t> sequences_;
+		std::vector<uint64_t> firsts_;
+		std::vector<uint64_t> trace_;
+		bool is_ordered_;
+	};
+
+	void simulate (simulation_t* simulation, const virtual_clock_t::time_point& origin) {
+		virtual_clock_t::reset (origin);
+		time_pump_t<virtual_clock_t> pump (origin, boost::chrono::microseconds (kResolutionUs), CATCHUP_COALESCE, boost::chrono::microseconds (0), simulation);
+		pump();
+	}
+} /* anonymous namespace */
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	using namespace boost::chrono;
+	const virtual_clock_t::time_point origin (seconds (1000000));
+
+	simulation_t first (origin);
+	simulate (&first, origin);
+	EXPECT(origin + seconds (kSeconds) == virtual_clock_t::now());
+	EXPECT(first.isOrdered());
+	uint64_t messages = 0;
+	for (size_t i = 0; i < kCount; ++i) {
+		const uint64_t last = kTicks - 1;
+		const uint64_t expected = first.firsts()[i] > last ? 0 : (last - first.firsts()[i]) / kIntervals[i] + 1;
+		if (expected != first.sequences()[i]) {
+			fprintf (stderr, "Handle %u: interval %u, %llu messages, expected %llu.\n",
+				static_cast<unsigned> (i), kIntervals[i],
+				static_cast<unsigned long long> (first.sequences()[i]),
+				static_cast<unsigned long long> (expected));
+			++failures;
+		}
+		messages += expected;
+	}
+	EXPECT(messages == first.trace().size());
+
+/* Same configuration, same output. */
+	simulation_t second (origin);
+	simulate (&second, origin);
+	EXPECT(first.trace() == second.trace());
+
+	if (failures > 0) {
+		fprintf (stderr, "%d failures.\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf ("Simulated %ds, %llu messages.\n", kSeconds, static_cast<unsigned long long> (messages));
+	puts ("simulation_test passed.");
+	return EXIT_SUCCESS;
+}
+
+/* eof */
@@ -0,0 +1,98 @@
+/* Timing wheel test: expiry order across levels and drift free re-arming.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "timing_wheel.hh"
+
+using namespace nezumi;
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+/* Every handle expires exactly on its tick whatever level it starts in. */
+static
+void
+test_expiry()
+{
+	static const uint64_t delays[] = { 0, 1, 2, 255, 256, 257, 65535, 65536, 65537, 1000000 };
+	const size_t count = sizeof (delays) / sizeof (delays[0]);
+	timing_wheel_t wheel;
+	wheel.reserve (count);
+	for (size_t i = 0; i < count; ++i)
+		wheel.schedule (static_cast<timing_wheel_t::handle_t> (i), delays[i]);
+	EXPECT(count == wheel.size());
+	std::vector<timing_wheel_t::handle_t> expired;
+	std::vector<uint64_t> fired (count, 0);
+	for (uint64_t tick = 1; tick <= 1000001; ++tick) {
+		expired.clear();
+		wheel.advance (tick, &expired);
+		for (auto it = expired.begin(); it != expired.end(); ++it)
+			fired[*it] = tick;
+	}
+	for (size_t i = 0; i < count; ++i)
+		EXPECT((0 == delays[i] ? 1 : delays[i]) == fired[i]);
+	EXPECT(0 == wheel.size());
+
+/* An absolute tick already passed expires on the next tick. */
+	wheel.scheduleAt (0, 5);
+	expired.clear();
+	EXPECT(1 == wheel.advance (wheel.now() + 1, &expired) && 0 == expired[0]);
+}
+
+/* Re-arming from the due tick keeps each handle on its phase when ticks are
+ * coalesced, as shard_t::publishDue().
+ */
+static
+void
+test_rearm()
+{
+	const uint64_t interval = 10;
+	const size_t count = 10;
+	timing_wheel_t wheel;
+	wheel.reserve (count);
+	for (size_t i = 0; i < count; ++i)
+		wheel.schedule (static_cast<timing_wheel_t::handle_t> (i), 1 + i);
+	std::vector<timing_wheel_t::handle_t> expired;
+	size_t published = 0;
+	for (uint64_t tick = 7; tick <= 1000; tick += 7) {
+		expired.clear();
+		wheel.advance (tick, &expired);
+		for (auto it = expired.begin(); it != expired.end(); ++it) {
+			EXPECT(0 == (wheel.expiry (*it) - 1 - *it) % interval);
+			wheel.scheduleAt (*it, wheel.expiry (*it) + interval);
+			++published;
+		}
+	}
+	for (size_t i = 0; i < count; ++i)
+		EXPECT(0 == (wheel.expiry (static_cast<timing_wheel_t::handle_t> (i)) - 1 - i) % interval);
+	EXPECT(count * 99 <= published && published <= count * 100);
+}
+
+int
+main (
+	int		argc,
+	char*		argv[]
+	)
+{
+	test_expiry();
+	test_rearm();
+	if (failures > 0) {
+		fprintf (stderr, "%d failures.\n", failures);
+		return EXIT_FAILURE;
+	}
+	puts ("timing_wheel_test passed.");
+	return EXIT_SUCCESS;
+}
+
+/* eof */